@@ -20,6 +20,7 @@
 
 #include "Lora.h"
 #include "SxRadio.h"
+#include "ArrayView.h"
 #include <vector>
 
 namespace lora {
@@ -608,6 +609,16 @@ namespace lora {
             SxRadio* GetRadio();                //!< Get pointer to the SxRadio object or assert if it is null
             Settings* GetSettings();            //!< Get pointer to the settings object or assert if it is null
 
+            /**
+             * Views of plan storage, read without copying into a new vector
+             * Valid until the plan is changed, fixed plans may compute channels in GetChannel
+             * and leave channel storage empty
+             */
+            ArrayView<Channel> GetChannelsView() const { return ArrayView<Channel>(_channels); }
+            ArrayView<Channel> GetDownlinkChannelsView() const { return ArrayView<Channel>(_dlChannels); }
+            ArrayView<Datarate> GetDataratesView() const { return ArrayView<Datarate>(_datarates); }
+            ArrayView<uint16_t> GetChannelMaskView() const { return ArrayView<uint16_t>(_channelMask); }
+
         protected:
 
             /**
@@ -615,6 +626,20 @@ namespace lora {
              */
             uint16_t CRC16(const uint8_t* data, size_t size);
 
+            /**
+             * Reserve plan storage for the largest size a region uses so it is allocated
+             * once when the plan is initialized and never grows or moves afterwards
+             * @param channels max uplink channels
+             * @param dlChannels max downlink channels
+             */
+            void ReserveStorage(uint8_t channels, uint8_t dlChannels) {
+                _datarates.reserve(16);
+                _channels.reserve(channels);
+                _dlChannels.reserve(dlChannels);
+                _dutyBands.reserve(8);
+                _channelMask.reserve((channels + 15) / 16);
+            }
+
             uint8_t _txChannel;                 //!< Current channel for transmit
             uint8_t _txFrequencySubBand;        //!< Current frequency sub band for hybrid operation
 
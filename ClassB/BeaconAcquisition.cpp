@@ -0,0 +1,158 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "BeaconAcquisition.h"
+#include "ChannelPlan.h"
+
+using namespace lora;
+
+BeaconAcquisition::BeaconAcquisition(ChannelPlan* plan, BeaconTracker* tracker)
+:
+  _plan(plan),
+  _tracker(tracker),
+  _mode(ACQUIRE_IDLE),
+  _hasTime(false),
+  _refGps(0),
+  _refLocal(0),
+  _refError(BEACON_ACQUISITION_TIME_ERROR),
+  _failures(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void BeaconAcquisition::SetTime(uint64_t gpsMs, uint32_t localMs, uint16_t errorMs) {
+    _refGps = gpsMs;
+    _refLocal = localMs;
+    _refError = errorMs;
+    _hasTime = true;
+}
+
+bool BeaconAcquisition::HasTime() const {
+    return _hasTime;
+}
+
+void BeaconAcquisition::Start() {
+    _failures = 0;
+    _mode = _hasTime ? ACQUIRE_TARGETED : ACQUIRE_WIDE;
+
+    logDebug("Beacon acquisition %s", _mode == ACQUIRE_TARGETED ? "targeted" : "wide");
+}
+
+void BeaconAcquisition::Stop() {
+    _mode = ACQUIRE_IDLE;
+}
+
+BeaconAcquisition::AcquisitionMode BeaconAcquisition::GetMode() const {
+    return _mode;
+}
+
+bool BeaconAcquisition::NextWindow(uint32_t localMs, BeaconWindow& window) {
+    const uint64_t period = DEFAULT_BEACON_PERIOD * 1000;
+
+    if (_mode == ACQUIRE_IDLE)
+        return false;
+
+    uint32_t uncertainty = 0;
+
+    if (_mode == ACQUIRE_TARGETED) {
+        // Padding doubles with each missed window until it spans a whole period
+        uncertainty = Uncertainty(localMs);
+
+        if (_failures >= 16 || ((uint64_t) uncertainty << _failures) * 2 >= period) {
+            logInfo("Beacon not found at expected time, switching to wide search");
+            _mode = ACQUIRE_WIDE;
+        } else {
+            uncertainty <<= _failures;
+        }
+    }
+
+    window.BeaconTime = 0;
+    window.Start = localMs;
+
+    if (_mode == ACQUIRE_TARGETED) {
+        // First beacon whose window has not started yet
+        uint64_t gps = GpsTime(localMs);
+        uint64_t beacon = (gps + uncertainty + period - 1) / period * period;
+        uint64_t delta = beacon - gps;
+
+        if (_tracker->IsLocked())
+            delta += (int64_t) delta * _tracker->GetDrift() / 1000000000LL;
+
+        window.BeaconTime = beacon / 1000;
+        window.Start = localMs + (uint32_t) delta - uncertainty;
+
+        // Beacon channel is fixed by the beacon time when hopping
+        _plan->FrequencyHop(window.BeaconTime, DEFAULT_BEACON_PERIOD, _plan->GetSettings()->Session.Address);
+    }
+
+    RxWindow rxw = _plan->GetRxWindow(RX_BEACON);
+    window.Frequency = rxw.Frequency;
+    window.Datarate = rxw.DatarateIndex;
+
+    if (_mode == ACQUIRE_TARGETED) {
+        window.Length = BEACON_PAD + 2 * uncertainty;
+        _stats.Targeted++;
+    } else {
+        window.Length = period + BEACON_RESERVED_TIME;
+        _stats.Wide++;
+    }
+
+    _stats.ListenMs += window.Length;
+
+    logDebug("Beacon window start: %lu len: %lu freq: %lu time: %lu", window.Start, window.Length, window.Frequency, window.BeaconTime);
+    return true;
+}
+
+void BeaconAcquisition::BeaconRx(const BeaconData_t& beacon, uint32_t localMs) {
+    // Beacon time is exact, use it as the new time reference
+    SetTime((uint64_t) beacon.Time * 1000, localMs, BEACON_TRACKER_JITTER_MS);
+    _tracker->BeaconRx(beacon.Time, localMs);
+
+    if (_mode != ACQUIRE_IDLE) {
+        logInfo("Beacon acquired after %lu ms of listening", _stats.ListenMs);
+        _stats.Acquired++;
+    }
+
+    _mode = ACQUIRE_IDLE;
+    _failures = 0;
+}
+
+void BeaconAcquisition::WindowMissed() {
+    if (_failures < 0xFF)
+        _failures++;
+
+    _tracker->BeaconMissed();
+}
+
+BeaconAcquisition::AcquisitionStats BeaconAcquisition::GetStats() const {
+    return _stats;
+}
+
+uint64_t BeaconAcquisition::GpsTime(uint32_t localMs) const {
+    return _refGps + (uint32_t) (localMs - _refLocal);
+}
+
+uint32_t BeaconAcquisition::Uncertainty(uint32_t localMs) const {
+    uint64_t elapsed = (uint32_t) (localMs - _refLocal);
+    uint64_t ppb = BEACON_TRACKER_DEFAULT_PPM * 1000;
+
+    // Allow 2 ppm of drift change since the estimate was made
+    if (_tracker->IsLocked())
+        ppb = (_tracker->GetDrift() < 0 ? -_tracker->GetDrift() : _tracker->GetDrift()) + 2000;
+
+    return _refError + (uint32_t) (elapsed * ppb / 1000000000ULL);
+}
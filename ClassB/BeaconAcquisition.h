@@ -0,0 +1,145 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ *
+ * @brief  lora::BeaconAcquisition targeted class B beacon search
+ *
+ * @details
+ *  Beacons are sent at GPS times that are a multiple of the beacon period. With
+ *  a GPS time reference passed to SetTime the next beacon time is known and so
+ *  is its channel, ChannelPlan::FrequencyHop is applied for that beacon time.
+ *  One short window is opened at the expected time and frequency, padded by the
+ *  error of the time reference plus the drift since it was taken.
+ *
+ *  Each missed window doubles the padding. Once the window would cover a whole
+ *  beacon period, or without a time reference, acquisition falls back to a
+ *  wide search listening through a full period.
+ *
+ *  The time reference is passed to SetTime, e.g. a time from mDot::getGPSTime,
+ *  and the caller opens the windows returned.
+ */
+
+#ifndef __BEACON_ACQUISITION_H__
+#define __BEACON_ACQUISITION_H__
+
+#include "Lora.h"
+#include "BeaconTracker.h"
+
+namespace lora {
+
+    class ChannelPlan;
+
+    const uint16_t BEACON_ACQUISITION_TIME_ERROR = 50;     //!< Default error of a network time reference in ms
+
+    /**
+     * Beacon receive window
+     */
+    typedef struct {
+            uint32_t Start;             //!< Local clock when window opens in ms
+            uint32_t Length;            //!< Window length in ms
+            uint32_t Frequency;         //!< Beacon frequency
+            uint32_t BeaconTime;        //!< GPS time of expected beacon in seconds, 0 if unknown
+            uint8_t Datarate;           //!< Beacon datarate index
+    } BeaconWindow;
+
+    class BeaconAcquisition {
+        public:
+
+            enum AcquisitionMode {
+                ACQUIRE_IDLE,           //!< Not searching
+                ACQUIRE_TARGETED,       //!< Short windows at expected beacon time
+                ACQUIRE_WIDE            //!< Full period windows
+            };
+
+            /**
+             * Acquisition counters
+             */
+            typedef struct {
+                    uint32_t Targeted;          //!< Targeted windows opened
+                    uint32_t Wide;              //!< Wide windows opened
+                    uint32_t Acquired;          //!< Searches ended by a beacon
+                    uint32_t ListenMs;          //!< Total length of windows opened
+            } AcquisitionStats;
+
+            /**
+             * BeaconAcquisition constructor
+             * @param plan ChannelPlan used for beacon frequency and datarate
+             * @param tracker BeaconTracker fed with acquired beacons and used for drift
+             */
+            BeaconAcquisition(ChannelPlan* plan, BeaconTracker* tracker);
+
+            /**
+             * Set the GPS time reference
+             * @param gpsMs ms since GPS epoch
+             * @param localMs local clock when gpsMs was valid
+             * @param errorMs error of the reference in ms
+             */
+            void SetTime(uint64_t gpsMs, uint32_t localMs, uint16_t errorMs = BEACON_ACQUISITION_TIME_ERROR);
+
+            /**
+             * Check if a time reference is set
+             */
+            bool HasTime() const;
+
+            /**
+             * Start searching, call after reset or BeaconLost
+             * A targeted search is used if a time reference is set, drift estimated by the tracker is kept
+             */
+            void Start();
+
+            /**
+             * Stop searching
+             */
+            void Stop();
+
+            /**
+             * Get current search mode
+             */
+            AcquisitionMode GetMode() const;
+
+            /**
+             * Plan the next receive window
+             * @param localMs local clock now
+             * @param[out] window window to open
+             * @return false if not searching
+             */
+            bool NextWindow(uint32_t localMs, BeaconWindow& window);
+
+            /**
+             * Beacon received in a search window, ends the search
+             * @param beacon decoded beacon
+             * @param localMs local clock at start of beacon
+             */
+            void BeaconRx(const BeaconData_t& beacon, uint32_t localMs);
+
+            /**
+             * No beacon received in the last window
+             */
+            void WindowMissed();
+
+            AcquisitionStats GetStats() const;
+
+        private:
+
+            uint64_t GpsTime(uint32_t localMs) const;
+            uint32_t Uncertainty(uint32_t localMs) const;
+
+            ChannelPlan* _plan;
+            BeaconTracker* _tracker;
+
+            AcquisitionMode _mode;
+            bool _hasTime;
+            uint64_t _refGps;                   //!< GPS time of reference in ms
+            uint32_t _refLocal;                 //!< Local clock at reference
+            uint16_t _refError;                 //!< Error of reference in ms
+            uint8_t _failures;                  //!< Targeted windows missed in a row
+
+            AcquisitionStats _stats;
+    };
+}
+
+#endif // __BEACON_ACQUISITION_H__
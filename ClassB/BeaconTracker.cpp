@@ -0,0 +1,156 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "BeaconTracker.h"
+
+using namespace lora;
+
+BeaconTracker::BeaconTracker()
+:
+  _received(0),
+  _missed(0)
+{
+    Reset();
+}
+
+void BeaconTracker::BeaconRx(uint32_t time, uint32_t localMs) {
+    _received++;
+    _missed = 0;
+
+    if (!_tracking || time <= _lastTime || time - _lastTime > MAX_BEACONLESS_OP_TIME) {
+        // Start a new estimate from this beacon
+        _tracking = true;
+        _locked = false;
+        _refTime = _midTime = _lastTime = time;
+        _refLocal = _midLocal = _lastLocal = localMs;
+        return;
+    }
+
+    uint32_t span = time - _refTime;
+    int64_t expected = (int64_t) span * 1000;
+    int64_t measured = (uint32_t) (localMs - _refLocal);
+    int64_t drift = (measured - expected) * 1000000000LL / expected;
+
+    if (drift > BEACON_TRACKER_MAX_PPM * 1000 || drift < -(BEACON_TRACKER_MAX_PPM * 1000)) {
+        logWarning("Beacon timing off by %ld ppb, restarting drift estimate", (int32_t) drift);
+        _locked = false;
+        _refTime = _midTime = _lastTime = time;
+        _refLocal = _midLocal = _lastLocal = localMs;
+        return;
+    }
+
+    _drift = (int32_t) drift;
+    _locked = true;
+    _lastTime = time;
+    _lastLocal = localMs;
+
+    // Keep between half and all of the max span of history so the estimate follows temperature
+    if (_midTime == _refTime && span >= BEACON_TRACKER_MAX_SPAN / 2) {
+        _midTime = time;
+        _midLocal = localMs;
+    }
+
+    if (span >= BEACON_TRACKER_MAX_SPAN) {
+        _refTime = _midTime;
+        _refLocal = _midLocal;
+        _midTime = time;
+        _midLocal = localMs;
+    }
+
+    logDebug("Beacon drift: %ld ppb span: %lu s", _drift, span);
+}
+
+void BeaconTracker::BeaconMissed() {
+    _missed++;
+}
+
+void BeaconTracker::Reset() {
+    _tracking = false;
+    _locked = false;
+    _drift = 0;
+    _refTime = _midTime = _lastTime = 0;
+    _refLocal = _midLocal = _lastLocal = 0;
+    _received = 0;
+    _missed = 0;
+}
+
+bool BeaconTracker::IsTracking() const {
+    return _tracking;
+}
+
+bool BeaconTracker::IsLocked() const {
+    return _locked;
+}
+
+int32_t BeaconTracker::GetDrift() const {
+    return _drift;
+}
+
+uint32_t BeaconTracker::GetBeaconlessTime(uint32_t localMs) const {
+    return _tracking ? localMs - _lastLocal : 0;
+}
+
+bool BeaconTracker::IsBeaconless(uint32_t localMs) const {
+    return !_tracking || GetBeaconlessTime(localMs) > MAX_BEACONLESS_OP_TIME * 1000;
+}
+
+uint32_t BeaconTracker::NextBeacon(uint32_t localMs) const {
+    int64_t period = DEFAULT_BEACON_PERIOD * 1000;
+    uint32_t elapsed = localMs - _lastLocal;
+
+    period += period * _drift / 1000000000LL;
+
+    return _lastLocal + (uint32_t) ((elapsed / period + 1) * period);
+}
+
+uint32_t BeaconTracker::GetWidening(uint32_t localMs) const {
+    if (!_tracking)
+        return 0;
+
+    uint64_t elapsed = GetBeaconlessTime(localMs);
+    uint64_t error = (_drift < 0 ? -_drift : _drift) + Uncertainty();
+
+    return (uint32_t) (elapsed * error / 1000000000ULL) + BEACON_TRACKER_JITTER_MS;
+}
+
+uint32_t BeaconTracker::GetWindow(uint32_t localMs, uint32_t baseMs) const {
+    uint32_t window = baseMs + 2 * GetWidening(localMs);
+    uint32_t max = baseMs * MAX_CLASS_B_WINDOW_GROWTH;
+
+    return window < max ? window : max;
+}
+
+uint32_t BeaconTracker::GetReceived() const {
+    return _received;
+}
+
+uint32_t BeaconTracker::GetMissed() const {
+    return _missed;
+}
+
+uint32_t BeaconTracker::Uncertainty() const {
+    if (!_locked)
+        return BEACON_TRACKER_DEFAULT_PPM * 1000;
+
+    // Both ends of the estimate span may be off by the reception jitter
+    uint64_t span = (uint64_t) (_lastTime - _refTime) * 1000;
+
+    if (span == 0)
+        return BEACON_TRACKER_DEFAULT_PPM * 1000;
+
+    return (uint32_t) (2ULL * BEACON_TRACKER_JITTER_MS * 1000000000ULL / span);
+}
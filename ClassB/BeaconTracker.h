@@ -0,0 +1,142 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ *
+ * @brief  lora::BeaconTracker local clock drift estimate for class B receive windows
+ *
+ * @details
+ *  Compares the local clock at successive beacon receptions with the GPS time
+ *  carried in the beacons to estimate the drift of the local oscillator. Beacon
+ *  and ping slot windows are then widened by the timing error the drift and
+ *  estimate uncertainty can build up since the last beacon, instead of a fixed
+ *  worst case pad. Until two beacons have been received a default crystal
+ *  tolerance is assumed.
+ *
+ *  Local times are ms of a free running clock, differences are taken with
+ *  unsigned arithmetic so the clock may wrap.
+ *
+ *  Received beacons are passed to BeaconRx and misses to BeaconMissed,
+ *  GetWindow gives the widened length of a receive window.
+ */
+
+#ifndef __BEACON_TRACKER_H__
+#define __BEACON_TRACKER_H__
+
+#include "Lora.h"
+
+namespace lora {
+
+    const uint16_t BEACON_TRACKER_DEFAULT_PPM = 40;     //!< Drift assumed before an estimate is available
+    const uint16_t BEACON_TRACKER_MAX_PPM = 200;        //!< Estimates beyond this are treated as a bad reception
+    const uint16_t BEACON_TRACKER_JITTER_MS = 2;        //!< Timestamp uncertainty of a beacon reception
+    const uint32_t BEACON_TRACKER_MAX_SPAN = 3600;      //!< Seconds of history used for the estimate
+
+    class BeaconTracker {
+        public:
+
+            BeaconTracker();
+
+            /**
+             * Record a received beacon
+             * @param time beacon time in seconds since GPS epoch
+             * @param localMs local clock at the start of the beacon
+             */
+            void BeaconRx(uint32_t time, uint32_t localMs);
+
+            /**
+             * Record a beacon window without reception
+             */
+            void BeaconMissed();
+
+            /**
+             * Drop all timing, next beacon starts a new estimate
+             */
+            void Reset();
+
+            /**
+             * Check if a beacon has been received since reset
+             */
+            bool IsTracking() const;
+
+            /**
+             * Check if drift has been estimated from at least two beacons
+             */
+            bool IsLocked() const;
+
+            /**
+             * Get estimated drift of local clock, positive when the local clock runs fast
+             * @return drift in parts per billion
+             */
+            int32_t GetDrift() const;
+
+            /**
+             * Get time since the last received beacon
+             * @param localMs local clock now
+             * @return ms since last beacon
+             */
+            uint32_t GetBeaconlessTime(uint32_t localMs) const;
+
+            /**
+             * Check if class B operation has to stop for lack of beacons
+             * @param localMs local clock now
+             * @return true if last beacon is older than MAX_BEACONLESS_OP_TIME
+             */
+            bool IsBeaconless(uint32_t localMs) const;
+
+            /**
+             * Get the local time of the next expected beacon
+             * @param localMs local clock now
+             * @return local clock at next beacon start, corrected for drift
+             */
+            uint32_t NextBeacon(uint32_t localMs) const;
+
+            /**
+             * Get the timing error that may have built up since the last beacon
+             * @param localMs local clock at the window
+             * @return ms the window must open early and close late
+             */
+            uint32_t GetWidening(uint32_t localMs) const;
+
+            /**
+             * Get the length of a beacon or ping slot receive window
+             * @param localMs local clock at the window
+             * @param baseMs window length with a perfect clock
+             * @return window length, at most MAX_CLASS_B_WINDOW_GROWTH times baseMs
+             */
+            uint32_t GetWindow(uint32_t localMs, uint32_t baseMs) const;
+
+            /**
+             * Get number of beacons received since reset
+             */
+            uint32_t GetReceived() const;
+
+            /**
+             * Get number of beacons missed since the last reception
+             */
+            uint32_t GetMissed() const;
+
+        private:
+
+            uint32_t Uncertainty() const;
+
+            bool _tracking;
+            bool _locked;
+            int32_t _drift;                     //!< Estimated drift in ppb
+
+            uint32_t _refTime;                  //!< Beacon time at start of estimate
+            uint32_t _refLocal;                 //!< Local clock at start of estimate
+            uint32_t _midTime;                  //!< Beacon time that becomes the next start of estimate
+            uint32_t _midLocal;                 //!< Local clock at _midTime
+            uint32_t _lastTime;                 //!< Beacon time of last reception
+            uint32_t _lastLocal;                //!< Local clock at last reception
+
+            uint32_t _received;
+            uint32_t _missed;
+    };
+}
+
+#endif // __BEACON_TRACKER_H__
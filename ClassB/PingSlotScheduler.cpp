@@ -0,0 +1,180 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "PingSlotScheduler.h"
+#include "ChannelPlan.h"
+
+using namespace lora;
+
+PingSlotScheduler::PingSlotScheduler(ChannelPlan* plan)
+:
+  _plan(plan),
+  _count(0),
+  _dropped(0),
+  _reserved(0),
+  _beaconTime(0)
+{
+    uint8_t key[AES_BLOCK_SIZE];
+
+    memset(key, 0, sizeof(key));
+    _aes.SetKey(key);
+}
+
+uint16_t PingSlotScheduler::BeaconRx(uint32_t time) {
+    Settings* settings = _plan->GetSettings();
+    Source sources[1 + MAX_MULTICAST_SESSIONS];
+    uint8_t count = 0;
+
+    _count = 0;
+    _dropped = 0;
+    _reserved = 0;
+    _beaconTime = time;
+
+    // Session frequencies follow the beacon time when hopping is enabled
+    _plan->FrequencyHop(time, DEFAULT_BEACON_PERIOD, settings->Session.Address);
+
+    if (settings->Session.Joined && settings->Session.Class == CLASS_B) {
+        count = AddSource(sources, count, time, settings->Session.Address, settings->Network.PingPeriodicity,
+                          settings->Session.PingSlotFrequency, settings->Session.PingSlotDatarateIndex, PING_SLOT_UNICAST);
+
+        // Hold entries for all unicast slots so multicast slots earlier in the window cannot use them
+        if (count > 0)
+            _reserved = PING_SLOT_COUNT / sources[0].Period;
+    }
+
+    for (uint8_t i = 0; i < MAX_MULTICAST_SESSIONS; i++) {
+        MulticastSession& session = settings->Multicast[i];
+
+        if (session.Address != 0) {
+            count = AddSource(sources, count, time, session.Address, session.Periodicity,
+                              session.Frequency, session.DatarateIndex, 1 << (i + 1));
+        }
+    }
+
+    // Merge the ascending slots of all sessions, ties go to the earlier session
+    while (true) {
+        int8_t next = -1;
+
+        for (uint8_t i = 0; i < count; i++) {
+            if (sources[i].Next < PING_SLOT_COUNT && (next < 0 || sources[i].Next < sources[next].Next))
+                next = i;
+        }
+
+        if (next < 0)
+            break;
+
+        Add(sources[next]);
+        sources[next].Next += sources[next].Period;
+    }
+
+    logDebug("Ping slots for beacon %lu: %u dropped: %u", time, _count, _dropped);
+    return _count;
+}
+
+void PingSlotScheduler::Clear() {
+    _count = 0;
+    _dropped = 0;
+}
+
+ArrayView<PingSlotEntry> PingSlotScheduler::GetTimeline() const {
+    return ArrayView<PingSlotEntry>(_timeline, _count);
+}
+
+int16_t PingSlotScheduler::NextSlot(uint32_t ms) const {
+    uint16_t lo = 0;
+    uint16_t hi = _count;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+
+        if (SlotTime(_timeline[mid].Slot) < ms)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < _count ? lo : -1;
+}
+
+uint32_t PingSlotScheduler::SlotTime(uint16_t slot) {
+    return BEACON_RESERVED_TIME + (uint32_t) slot * PING_SLOT_LENGTH;
+}
+
+uint16_t PingSlotScheduler::PingOffset(uint32_t time, uint32_t address, uint16_t period) const {
+    uint8_t block[AES_BLOCK_SIZE];
+
+    // Rand = aes128_encrypt(0, BeaconTime | DevAddr | pad16)
+    memset(block, 0, sizeof(block));
+    memcpy(block, &time, sizeof(time));
+    memcpy(block + 4, &address, sizeof(address));
+
+    _aes.Encrypt(block, block);
+
+    return (block[0] + block[1] * 256) % period;
+}
+
+uint32_t PingSlotScheduler::GetBeaconTime() const {
+    return _beaconTime;
+}
+
+uint16_t PingSlotScheduler::GetDropped() const {
+    return _dropped;
+}
+
+uint8_t PingSlotScheduler::AddSource(Source* sources, uint8_t count, uint32_t time, uint32_t address, int8_t periodicity, uint32_t freq, uint8_t dr, uint16_t bit) {
+    if (periodicity < 0 || periodicity > 7)
+        return count;
+
+    Source& source = sources[count];
+
+    // 2^(7 - periodicity) pings per beacon, period of 2^(5 + periodicity) slots
+    source.Period = 1 << (5 + periodicity);
+    source.Next = PingOffset(time, address, source.Period);
+    source.Frequency = freq;
+    source.Datarate = dr;
+    source.Bit = bit;
+
+    return count + 1;
+}
+
+void PingSlotScheduler::Add(const Source& source) {
+    if (source.Bit == PING_SLOT_UNICAST && _reserved > 0)
+        _reserved--;
+
+    if (_count > 0 && _timeline[_count - 1].Slot == source.Next) {
+        PingSlotEntry& last = _timeline[_count - 1];
+
+        if (last.Frequency == source.Frequency && last.Datarate == source.Datarate) {
+            last.Sessions |= source.Bit;
+        } else {
+            // Radio can only listen on one channel, slot stays with the earlier session
+            _dropped++;
+        }
+        return;
+    }
+
+    if (_count + (source.Bit == PING_SLOT_UNICAST ? 0 : _reserved) >= PING_SLOT_TABLE_SIZE) {
+        _dropped++;
+        return;
+    }
+
+    _timeline[_count].Frequency = source.Frequency;
+    _timeline[_count].Slot = source.Next;
+    _timeline[_count].Sessions = source.Bit;
+    _timeline[_count].Datarate = source.Datarate;
+    _count++;
+}
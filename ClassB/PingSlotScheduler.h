@@ -0,0 +1,147 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ *
+ * @brief  lora::PingSlotScheduler class B ping slot timeline for one beacon period
+ *
+ * @details
+ *  On each received beacon the ping offsets of the unicast session and of every
+ *  active multicast session are computed once and merged into one ordered
+ *  timeline of slots with frequency, datarate and the sessions listening. Slots
+ *  of different sessions falling on the same slot, frequency and datarate are
+ *  merged into one receive window. When sessions collide on the same slot with
+ *  different radio settings the unicast session, then the lowest multicast
+ *  index, keeps the slot.
+ *
+ *  Frequencies are taken from the session after ChannelPlan::FrequencyHop has
+ *  been applied for the beacon time.
+ *
+ *  The timeline always has room for every unicast slot, up to 128 at
+ *  periodicity 0, multicast slots share the remaining entries.
+ *
+ *  BeaconRx is called for each received beacon, the windows to open are read
+ *  with GetTimeline or NextSlot.
+ */
+
+#ifndef __PING_SLOT_SCHEDULER_H__
+#define __PING_SLOT_SCHEDULER_H__
+
+#include "Lora.h"
+#include "Aes128.h"
+#include "ArrayView.h"
+
+namespace lora {
+
+    class ChannelPlan;
+
+    const uint16_t PING_SLOT_COUNT = 4096;          //!< Number of slots in a beacon window, 2^12
+    const uint16_t PING_SLOT_UNICAST_MAX = 128;     //!< Unicast slots at periodicity 0, 2^12 / 2^5
+#if defined(TARGET_MTS_MDOT_F411RE)
+    const uint16_t PING_SLOT_MULTICAST_MAX = 128;   //!< Timeline entries for multicast only slots
+#else
+    const uint16_t PING_SLOT_MULTICAST_MAX = 64;    //!< Timeline entries for multicast only slots
+#endif
+    const uint16_t PING_SLOT_TABLE_SIZE = PING_SLOT_UNICAST_MAX + PING_SLOT_MULTICAST_MAX; //!< Max slots in a beacon period timeline
+    const uint16_t PING_SLOT_UNICAST = 0x0001;      //!< Session bit of the unicast session, multicast index i is bit i + 1
+
+    /**
+     * Receive window in the ping slot timeline
+     */
+    typedef struct {
+            uint32_t Frequency;         //!< Frequency of the window
+            uint16_t Slot;              //!< Slot index in beacon window
+            uint16_t Sessions;          //!< Sessions listening in this slot
+            uint8_t Datarate;           //!< Datarate of the window
+    } PingSlotEntry;
+
+    class PingSlotScheduler {
+        public:
+
+            /**
+             * PingSlotScheduler constructor
+             * @param plan ChannelPlan used for settings and frequency hopping
+             */
+            PingSlotScheduler(ChannelPlan* plan);
+
+            /**
+             * Build the timeline for the beacon period starting at a received beacon
+             * @param time beacon time in seconds since GPS epoch
+             * @return number of slots in the timeline
+             */
+            uint16_t BeaconRx(uint32_t time);
+
+            /**
+             * Drop the timeline, no slots are scheduled until the next beacon
+             */
+            void Clear();
+
+            /**
+             * Get the ordered timeline of the current beacon period
+             */
+            ArrayView<PingSlotEntry> GetTimeline() const;
+
+            /**
+             * Find the next slot starting at or after a time in the beacon period
+             * @param ms time since the start of the beacon in ms
+             * @return index in timeline or -1 if no slot is left
+             */
+            int16_t NextSlot(uint32_t ms) const;
+
+            /**
+             * Get the start of a slot relative to the start of the beacon
+             * @param slot slot index in beacon window
+             * @return time in ms
+             */
+            static uint32_t SlotTime(uint16_t slot);
+
+            /**
+             * Compute the ping offset of an address for a beacon
+             * @param time beacon time in seconds since GPS epoch
+             * @param address device or multicast address
+             * @param period ping period in slots
+             * @return first slot of the address in the beacon window
+             */
+            uint16_t PingOffset(uint32_t time, uint32_t address, uint16_t period) const;
+
+            /**
+             * Get beacon time of the current timeline
+             */
+            uint32_t GetBeaconTime() const;
+
+            /**
+             * Get number of slots that did not fit in the timeline or lost a collision
+             */
+            uint16_t GetDropped() const;
+
+        private:
+
+            /**
+             * Ping slots of one session
+             */
+            typedef struct {
+                    uint32_t Frequency;
+                    uint16_t Next;              //!< Next slot of the session
+                    uint16_t Period;            //!< Slots between pings
+                    uint16_t Bit;               //!< Session bit
+                    uint8_t Datarate;
+            } Source;
+
+            uint8_t AddSource(Source* sources, uint8_t count, uint32_t time, uint32_t address, int8_t periodicity, uint32_t freq, uint8_t dr, uint16_t bit);
+            void Add(const Source& source);
+
+            ChannelPlan* _plan;
+            Aes128 _aes;                        //!< Zero key cipher for ping offsets
+
+            PingSlotEntry _timeline[PING_SLOT_TABLE_SIZE];
+            uint16_t _count;
+            uint16_t _dropped;
+            uint16_t _reserved;                 //!< Entries held for unicast slots still to be added
+            uint32_t _beaconTime;
+    };
+}
+
+#endif // __PING_SLOT_SCHEDULER_H__
@@ -0,0 +1,224 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::Aes128 AES-128 block encryption with a stored key schedule
+ *
+ * @details
+ *  The key schedule is expanded once by SetKey and reused for every block.
+ *  Only the forward cipher is provided, LoRaWAN uses AES in CMAC and CTR
+ *  modes and never decrypts a block. Each backend provides the block cipher
+ *  and both modes, the software backends build the modes on their block
+ *  cipher with AesCmac and AesCtr. With AES_HW_MODES the hardware backend
+ *  passes whole messages to aes_hw_cmac and aes_hw_ctr for peripherals that
+ *  run the modes themselves.
+ *
+ *  The block cipher backend is selected at build time with AES_BACKEND:
+ *   AES_BACKEND_REFERENCE  byte oriented, smallest flash and RAM
+ *   AES_BACKEND_TTABLE     32-bit table lookups, about 1 kB more flash
+ *   AES_BACKEND_HARDWARE   blocks are passed to aes_hw_encrypt provided by
+ *                          the application for targets with an AES peripheral
+ */
+
+#ifndef __AES128_H__
+#define __AES128_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AES_BACKEND_REFERENCE 0
+#define AES_BACKEND_TTABLE 1
+#define AES_BACKEND_HARDWARE 2
+
+#if !defined(AES_BACKEND)
+#if defined(TARGET_XDOT_L151CC)
+#define AES_BACKEND AES_BACKEND_REFERENCE
+#else
+#define AES_BACKEND AES_BACKEND_TTABLE
+#endif
+#endif
+
+#if AES_BACKEND == AES_BACKEND_HARDWARE
+/**
+ * Encrypt one block with an AES peripheral, provided by the application
+ * Called with the key of the context for every block, the implementation
+ * should only reload the key register when it changes
+ * @param key 16 byte key
+ * @param in 16 byte plain block
+ * @param out 16 byte cipher block, may be the same as in
+ */
+extern "C" void aes_hw_encrypt(const uint8_t* key, const uint8_t* in, uint8_t* out);
+
+#if defined(AES_HW_MODES)
+/**
+ * Compute AES-CMAC with an AES peripheral, provided by the application
+ * @param key 16 byte key
+ * @param b0 optional 16 byte block processed before data, NULL if none
+ * @param data message
+ * @param size bytes in message
+ * @param mac 16 byte CMAC
+ */
+extern "C" void aes_hw_cmac(const uint8_t* key, const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac);
+
+/**
+ * Encrypt or decrypt in CTR mode with an AES peripheral, provided by the application
+ * @param key 16 byte key
+ * @param counter 16 byte counter block, incremented past the last block used
+ * @param data message, processed in place
+ * @param size bytes in message
+ */
+extern "C" void aes_hw_ctr(const uint8_t* key, uint8_t* counter, uint8_t* data, uint16_t size);
+#endif
+#endif
+
+namespace lora {
+
+    const uint8_t AES_BLOCK_SIZE = 16;                      //!< Number of bytes in an AES block
+    const uint8_t AES_ROUNDS = 10;                          //!< Number of rounds for a 128-bit key
+    const uint8_t AES_SCHEDULE_SIZE = 16 * (AES_ROUNDS + 1);   //!< Number of bytes in an expanded key schedule
+
+    extern const uint8_t AES_SBOX[256];         //!< Forward S-box shared by the backends
+
+    /**
+     * AES-CMAC on the block cipher of a backend
+     * @param aes backend holding the key
+     * @param k1 16 byte CMAC subkey K1 of the key
+     * @param k2 16 byte CMAC subkey K2 of the key
+     * @param b0 optional 16 byte block processed before data, NULL if none
+     * @param data message
+     * @param size bytes in message
+     * @param[out] mac 16 byte CMAC
+     */
+    template <class Cipher>
+    void AesCmac(const Cipher& aes, const uint8_t* k1, const uint8_t* k2, const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) {
+        uint8_t x[AES_BLOCK_SIZE] = { 0 };
+        uint16_t pos = 0;
+
+        if (b0 != NULL) {
+            if (size == 0) {
+                // B0 is the only and complete block
+                for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) {
+                    mac[i] = b0[i] ^ k1[i];
+                }
+                aes.Encrypt(mac, mac);
+                return;
+            }
+
+            aes.Encrypt(b0, x);
+        }
+
+        while (size - pos > AES_BLOCK_SIZE) {
+            for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) {
+                x[i] ^= data[pos + i];
+            }
+            aes.Encrypt(x, x);
+            pos += AES_BLOCK_SIZE;
+        }
+
+        // Last block is complete and masked with K1, or padded and masked with K2
+        uint8_t last = size - pos;
+        const uint8_t* k = (last == AES_BLOCK_SIZE) ? k1 : k2;
+
+        for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) {
+            uint8_t m = (i < last) ? data[pos + i] : (i == last) ? 0x80 : 0x00;
+            x[i] ^= m ^ k[i];
+        }
+
+        aes.Encrypt(x, mac);
+    }
+
+    /**
+     * CTR mode on the block cipher of a backend, encryption and decryption are the same
+     * The counter block is incremented as a 128-bit big endian number, for LoRaWAN frames
+     * this steps the block index in the last byte
+     * @param aes backend holding the key
+     * @param counter 16 byte counter block, incremented past the last block used
+     * @param data message, processed in place
+     * @param size bytes in message
+     */
+    template <class Cipher>
+    void AesCtr(const Cipher& aes, uint8_t* counter, uint8_t* data, uint16_t size) {
+        uint8_t s[AES_BLOCK_SIZE];
+
+        for (uint16_t pos = 0; pos < size; pos += AES_BLOCK_SIZE) {
+            aes.Encrypt(counter, s);
+
+            for (uint8_t i = 0; i < AES_BLOCK_SIZE && pos + i < size; i++) {
+                data[pos + i] ^= s[i];
+            }
+
+            for (int8_t i = AES_BLOCK_SIZE - 1; i >= 0; i--) {
+                if (++counter[i] != 0)
+                    break;
+            }
+
+            if (size - pos <= AES_BLOCK_SIZE)
+                break;
+        }
+    }
+
+    /**
+     * Byte oriented AES, one S-box lookup per byte and MixColumns computed with xtime
+     */
+    class AesReference {
+        public:
+            AesReference();
+            ~AesReference();
+            void SetKey(const uint8_t* key);
+            void Encrypt(const uint8_t* in, uint8_t* out) const;
+            void Cmac(const uint8_t* k1, const uint8_t* k2, const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) const;
+            void Ctr(uint8_t* counter, uint8_t* data, uint16_t size) const;
+            void Clear();
+
+        private:
+            uint8_t _schedule[AES_SCHEDULE_SIZE];
+    };
+
+    /**
+     * 32-bit AES, SubBytes, ShiftRows and MixColumns of a column are four table lookups
+     * One table is stored and rotated for the other three to save flash
+     */
+    class AesTTable {
+        public:
+            AesTTable();
+            ~AesTTable();
+            void SetKey(const uint8_t* key);
+            void Encrypt(const uint8_t* in, uint8_t* out) const;
+            void Cmac(const uint8_t* k1, const uint8_t* k2, const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) const;
+            void Ctr(uint8_t* counter, uint8_t* data, uint16_t size) const;
+            void Clear();
+
+        private:
+            uint32_t _schedule[AES_SCHEDULE_SIZE / 4];
+    };
+
+    /**
+     * AES peripheral, the key is kept and passed to aes_hw_encrypt with each block
+     */
+    class AesHardware {
+        public:
+            AesHardware();
+            ~AesHardware();
+            void SetKey(const uint8_t* key);
+            void Encrypt(const uint8_t* in, uint8_t* out) const;
+            void Cmac(const uint8_t* k1, const uint8_t* k2, const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) const;
+            void Ctr(uint8_t* counter, uint8_t* data, uint16_t size) const;
+            void Clear();
+
+        private:
+            uint8_t _key[16];
+    };
+
+#if AES_BACKEND == AES_BACKEND_HARDWARE
+    typedef AesHardware Aes128;
+#elif AES_BACKEND == AES_BACKEND_TTABLE
+    typedef AesTTable Aes128;
+#else
+    typedef AesReference Aes128;
+#endif
+}
+
+#endif // __AES128_H__
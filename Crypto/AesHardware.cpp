@@ -0,0 +1,65 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "Aes128.h"
+
+#include <string.h>
+
+#if AES_BACKEND == AES_BACKEND_HARDWARE
+
+using namespace lora;
+
+AesHardware::AesHardware() {
+    Clear();
+}
+
+AesHardware::~AesHardware() {
+    Clear();
+}
+
+void AesHardware::SetKey(const uint8_t* key) {
+    memcpy(_key, key, sizeof(_key));
+}
+
+void AesHardware::Encrypt(const uint8_t* in, uint8_t* out) const {
+    aes_hw_encrypt(_key, in, out);
+}
+
+void AesHardware::Cmac(const uint8_t* k1, const uint8_t* k2, const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) const {
+#if defined(AES_HW_MODES)
+    // Peripheral derives its own subkeys
+    (void) k1;
+    (void) k2;
+    aes_hw_cmac(_key, b0, data, size, mac);
+#else
+    AesCmac(*this, k1, k2, b0, data, size, mac);
+#endif
+}
+
+void AesHardware::Ctr(uint8_t* counter, uint8_t* data, uint16_t size) const {
+#if defined(AES_HW_MODES)
+    aes_hw_ctr(_key, counter, data, size);
+#else
+    AesCtr(*this, counter, data, size);
+#endif
+}
+
+void AesHardware::Clear() {
+    memset(_key, 0, sizeof(_key));
+}
+
+#endif /* AES_BACKEND_HARDWARE */
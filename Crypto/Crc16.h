@@ -0,0 +1,55 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ *
+ * @brief  lora::Crc16 table driven CRC-16 CCITT
+ *
+ * @details
+ *  CRC-16 with the ITU-T polynomial 0x1021, most significant bit first and no
+ *  final XOR. With an initial value of 0 this is the CRC of LoRaWAN beacons
+ *  computed by ChannelPlan::CRC16, stored records use an initial value of
+ *  0xFFFF. One 256 entry table lookup replaces eight shift steps per byte.
+ */
+
+#ifndef __CRC16_H__
+#define __CRC16_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace lora {
+
+    const uint16_t CRC16_BEACON_INIT = 0x0000;      //!< Initial value for beacon CRCs
+    const uint16_t CRC16_RECORD_INIT = 0xFFFF;      //!< Initial value for stored records
+
+    extern const uint16_t CRC16_TABLE[256];         //!< CRC of each byte value
+
+    class Crc16 {
+        public:
+
+            /**
+             * Compute the CRC of a buffer
+             * @param data buffer
+             * @param size number of bytes
+             * @param crc initial value or CRC of preceding data
+             * @return CRC
+             */
+            static uint16_t Compute(const uint8_t* data, size_t size, uint16_t crc = CRC16_BEACON_INIT);
+
+            /**
+             * Add one byte to a CRC
+             * @param crc CRC of preceding data
+             * @param byte next byte
+             * @return CRC
+             */
+            static inline uint16_t Update(uint16_t crc, uint8_t byte) {
+                return (crc << 8) ^ CRC16_TABLE[(crc >> 8) ^ byte];
+            }
+    };
+}
+
+#endif // __CRC16_H__
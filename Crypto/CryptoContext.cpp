@@ -0,0 +1,168 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "CryptoContext.h"
+
+using namespace lora;
+
+static const uint8_t MIC_BLOCK = 0x49;
+static const uint8_t CRYPT_BLOCK = 0x01;
+
+static void ShiftLeft(const uint8_t* in, uint8_t* out) {
+    // Subkey generation, shift left one bit and reduce
+    uint8_t msb = in[0] & 0x80;
+
+    for (uint8_t i = 0; i < AES_BLOCK_SIZE - 1; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+
+    out[AES_BLOCK_SIZE - 1] = (in[AES_BLOCK_SIZE - 1] << 1) ^ (msb ? 0x87 : 0x00);
+}
+
+CryptoContext::CryptoContext()
+:
+  _valid(false)
+{
+    Clear();
+}
+
+CryptoContext::~CryptoContext() {
+    Clear();
+}
+
+void CryptoContext::SetKey(const uint8_t* key) {
+    uint8_t l[AES_BLOCK_SIZE] = { 0 };
+
+    memcpy(_key, key, KEY_SIZE);
+    _aes.SetKey(key);
+
+    _aes.Encrypt(l, l);
+    ShiftLeft(l, _k1);
+    ShiftLeft(_k1, _k2);
+
+    memset(l, 0, sizeof(l));
+    _valid = true;
+}
+
+bool CryptoContext::IsValid() const {
+    return _valid;
+}
+
+bool CryptoContext::Matches(const uint8_t* key) const {
+    return _valid && memcmp(_key, key, KEY_SIZE) == 0;
+}
+
+const uint8_t* CryptoContext::GetKey() const {
+    return _key;
+}
+
+void CryptoContext::Clear() {
+    _aes.Clear();
+    memset(_key, 0, sizeof(_key));
+    memset(_k1, 0, sizeof(_k1));
+    memset(_k2, 0, sizeof(_k2));
+    _valid = false;
+}
+
+void CryptoContext::Encrypt(const uint8_t* in, uint8_t* out) const {
+    _aes.Encrypt(in, out);
+}
+
+void CryptoContext::Cmac(const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) const {
+    _aes.Cmac(_k1, _k2, b0, data, size, mac);
+}
+
+uint32_t CryptoContext::ComputeMic(CryptoDirection dir, uint32_t address, uint32_t counter, const uint8_t* data, uint8_t size) const {
+    uint8_t b0[AES_BLOCK_SIZE];
+    uint8_t mac[AES_BLOCK_SIZE];
+
+    FrameBlock(b0, MIC_BLOCK, dir, address, counter, size);
+    Cmac(b0, data, size, mac);
+
+    return mac[0] | (mac[1] << 8) | (mac[2] << 16) | ((uint32_t) mac[3] << 24);
+}
+
+void CryptoContext::Crypt(CryptoDirection dir, uint32_t address, uint32_t counter, uint8_t* data, uint8_t size) const {
+    uint8_t a[AES_BLOCK_SIZE];
+
+    // Block index in the last byte of A starts at 1 and is stepped by the backend
+    FrameBlock(a, CRYPT_BLOCK, dir, address, counter, 1);
+    _aes.Ctr(a, data, size);
+}
+
+void CryptoContext::FrameBlock(uint8_t* block, uint8_t first, CryptoDirection dir, uint32_t address, uint32_t counter, uint8_t last) {
+    block[0] = first;
+    block[1] = 0x00;
+    block[2] = 0x00;
+    block[3] = 0x00;
+    block[4] = 0x00;
+    block[5] = dir;
+    block[6] = address & 0xFF;
+    block[7] = (address >> 8) & 0xFF;
+    block[8] = (address >> 16) & 0xFF;
+    block[9] = (address >> 24) & 0xFF;
+    block[10] = counter & 0xFF;
+    block[11] = (counter >> 8) & 0xFF;
+    block[12] = (counter >> 16) & 0xFF;
+    block[13] = (counter >> 24) & 0xFF;
+    block[14] = 0x00;
+    block[15] = last;
+}
+
+CryptoCache::CryptoCache()
+:
+  _seq(0)
+{
+    memset(_used, 0, sizeof(_used));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+const CryptoContext& CryptoCache::Get(const uint8_t* key) {
+    uint8_t oldest = 0;
+
+    _seq++;
+
+    for (uint8_t i = 0; i < CRYPTO_CACHE_SIZE; i++) {
+        if (_contexts[i].Matches(key)) {
+            _used[i] = _seq;
+            _stats.Hits++;
+            return _contexts[i];
+        }
+
+        if (!_contexts[i].IsValid() || (_contexts[oldest].IsValid() && _used[i] < _used[oldest])) {
+            oldest = i;
+        }
+    }
+
+    logTrace("Expanding key into crypto context %d", oldest);
+    _contexts[oldest].SetKey(key);
+    _used[oldest] = _seq;
+    _stats.Expansions++;
+
+    return _contexts[oldest];
+}
+
+void CryptoCache::Clear() {
+    for (uint8_t i = 0; i < CRYPTO_CACHE_SIZE; i++) {
+        _contexts[i].Clear();
+        _used[i] = 0;
+    }
+}
+
+const CryptoCache::CryptoStats& CryptoCache::GetStats() {
+    return _stats;
+}
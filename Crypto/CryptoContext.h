@@ -0,0 +1,185 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::CryptoContext holds the expanded state of one session key
+ *
+ * @details
+ *  A context expands the AES key schedule and derives the CMAC subkeys K1 and K2
+ *  once when its key is set, frame MIC and payload encryption then only cost the
+ *  block operations.
+ *
+ *  lora::CryptoCache keeps contexts for the most recently used keys. Contexts are
+ *  looked up by key value so a key changed by join accept, setNetworkSessionKey,
+ *  setMulticastSession or multicast key setup simply misses and is expanded once.
+ */
+
+#ifndef __CRYPTO_CONTEXT_H__
+#define __CRYPTO_CONTEXT_H__
+
+#include "Lora.h"
+#include "Aes128.h"
+
+namespace lora {
+
+#if defined(TARGET_XDOT_L151CC)
+    const uint8_t CRYPTO_CACHE_SIZE = 2;        //!< Number of key contexts kept, network and application session keys
+#else
+    const uint8_t CRYPTO_CACHE_SIZE = 4;        //!< Number of key contexts kept, session keys and one multicast group
+#endif
+
+    const uint8_t MIC_SIZE = 4;                 //!< Number of bytes in a frame MIC
+
+    /**
+     * Direction of a frame for MIC and encryption blocks
+     */
+    enum CryptoDirection {
+        CRYPTO_UPLINK = 0,
+        CRYPTO_DOWNLINK = 1
+    };
+
+    class CryptoContext {
+        public:
+
+            /**
+             * CryptoContext constructor, context is invalid until SetKey is called
+             */
+            CryptoContext();
+
+            /**
+             * CryptoContext destructor, clears key material
+             */
+            ~CryptoContext();
+
+            /**
+             * Expand the key schedule and derive the CMAC subkeys
+             * @param key 16 byte key
+             */
+            void SetKey(const uint8_t* key);
+
+            /**
+             * Check if context holds a key
+             */
+            bool IsValid() const;
+
+            /**
+             * Check if context holds the given key
+             * @param key 16 byte key
+             */
+            bool Matches(const uint8_t* key) const;
+
+            /**
+             * Get the key held by context
+             * @return 16 byte key
+             */
+            const uint8_t* GetKey() const;
+
+            /**
+             * Clear key material and invalidate context
+             */
+            void Clear();
+
+            /**
+             * Encrypt one block
+             * @param in 16 byte plain block
+             * @param out 16 byte cipher block, may be the same as in
+             */
+            void Encrypt(const uint8_t* in, uint8_t* out) const;
+
+            /**
+             * Compute AES-CMAC
+             * @param b0 optional 16 byte block processed before data, NULL if none
+             * @param data message
+             * @param size bytes in message
+             * @param[out] mac 16 byte CMAC
+             */
+            void Cmac(const uint8_t* b0, const uint8_t* data, uint16_t size, uint8_t* mac) const;
+
+            /**
+             * Compute the MIC of a data frame
+             * @param dir frame direction
+             * @param address device or multicast address
+             * @param counter full 32-bit frame counter
+             * @param data frame from MHDR to end of payload
+             * @param size bytes in frame
+             * @return MIC in frame byte order
+             */
+            uint32_t ComputeMic(CryptoDirection dir, uint32_t address, uint32_t counter, const uint8_t* data, uint8_t size) const;
+
+            /**
+             * Encrypt or decrypt a frame payload in place
+             * @param dir frame direction
+             * @param address device or multicast address
+             * @param counter full 32-bit frame counter
+             * @param data payload
+             * @param size bytes in payload
+             */
+            void Crypt(CryptoDirection dir, uint32_t address, uint32_t counter, uint8_t* data, uint8_t size) const;
+
+            /**
+             * Fill the B0 or A block of a data frame
+             * @param block 16 byte block
+             * @param first first byte, 0x49 for B0 and 0x01 for A
+             * @param dir frame direction
+             * @param address device or multicast address
+             * @param counter full 32-bit frame counter
+             * @param last last byte, message length for B0 and block index for A
+             */
+            static void FrameBlock(uint8_t* block, uint8_t first, CryptoDirection dir, uint32_t address, uint32_t counter, uint8_t last);
+
+        private:
+
+            Aes128 _aes;
+            uint8_t _key[KEY_SIZE];
+            uint8_t _k1[AES_BLOCK_SIZE];
+            uint8_t _k2[AES_BLOCK_SIZE];
+            bool _valid;
+    };
+
+    class CryptoCache {
+        public:
+
+            /**
+             * Key cache statistics
+             */
+            typedef struct {
+                    uint32_t Hits;          //!< Number of lookups served from an expanded context
+                    uint32_t Expansions;    //!< Number of key schedules expanded
+            } CryptoStats;
+
+            /**
+             * CryptoCache constructor
+             */
+            CryptoCache();
+
+            /**
+             * Get the context for a key, expanding it if not cached
+             * Least recently used context is replaced on a miss
+             * @param key 16 byte key
+             * @return context for key
+             */
+            const CryptoContext& Get(const uint8_t* key);
+
+            /**
+             * Clear all contexts, use when keys must not stay in memory
+             */
+            void Clear();
+
+            /**
+             * Get key cache statistics
+             */
+            const CryptoStats& GetStats();
+
+        private:
+
+            CryptoContext _contexts[CRYPTO_CACHE_SIZE];
+            uint32_t _used[CRYPTO_CACHE_SIZE];          //!< Lookup sequence of last use per context
+            uint32_t _seq;
+            CryptoStats _stats;
+    };
+}
+
+#endif // __CRYPTO_CONTEXT_H__
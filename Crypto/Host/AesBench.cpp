@@ -0,0 +1,93 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "AesBench.h"
+#include "MTSLog.h"
+
+#if defined(CRYPTO_HOST)
+#include <chrono>
+#include <vector>
+
+using namespace lora;
+
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint32_t megabytesPerSecond(uint64_t bytes, uint32_t us) {
+    return us ? (uint32_t) (bytes / us) : 0;
+}
+
+AesBench::BenchResult AesBench::Run(uint16_t size, uint32_t iterations) {
+    static const uint8_t KEY[AES_BLOCK_SIZE] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    uint16_t blocks = (size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+    std::vector<uint8_t> data(blocks * AES_BLOCK_SIZE + AES_BLOCK_SIZE);
+    uint8_t k1[AES_BLOCK_SIZE];
+    uint8_t k2[AES_BLOCK_SIZE];
+    uint8_t counter[AES_BLOCK_SIZE] = { 0 };
+    uint8_t mac[AES_BLOCK_SIZE] = { 0 };
+    BenchResult result;
+    Aes128 aes;
+
+    for (uint32_t i = 0; i < data.size(); i++) {
+        data[i] = (i * 151 + 17) & 0xFF;
+    }
+
+    // Subkeys only need to differ for the timing, CryptoContext derives the real ones
+    aes.SetKey(KEY);
+    aes.Encrypt(mac, k1);
+    aes.Encrypt(k1, k2);
+
+    result.Size = size;
+    result.Iterations = iterations;
+
+    // Each run feeds its output back into the data so the loops are not optimized away
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint16_t b = 0; b < blocks; b++) {
+            aes.Encrypt(&data[b * AES_BLOCK_SIZE], &data[b * AES_BLOCK_SIZE]);
+        }
+    }
+    result.BlockUs = elapsedUs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        aes.Cmac(k1, k2, NULL, &data[0], size, mac);
+        data[0] ^= mac[0];
+    }
+    result.CmacUs = elapsedUs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        aes.Ctr(counter, &data[0], size);
+    }
+    result.CtrUs = elapsedUs(start);
+
+    return result;
+}
+
+void AesBench::Report(const BenchResult& result) {
+    uint16_t blocks = (result.Size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+    uint64_t block_bytes = (uint64_t) blocks * AES_BLOCK_SIZE * result.Iterations;
+    uint64_t bytes = (uint64_t) result.Size * result.Iterations;
+
+    logInfo("AES backend %d %lu bytes x %lu block %lu MB/s cmac %lu MB/s ctr %lu MB/s", AES_BACKEND, result.Size, result.Iterations,
+            megabytesPerSecond(block_bytes, result.BlockUs), megabytesPerSecond(bytes, result.CmacUs),
+            megabytesPerSecond(bytes, result.CtrUs));
+}
+
+#endif
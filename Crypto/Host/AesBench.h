@@ -0,0 +1,58 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::AesBench measures the AES backend on a host
+ *
+ * @details
+ *  Measures the throughput of the block cipher, CMAC and CTR of the backend
+ *  selected by AES_BACKEND, the operations behind frame MICs and payload
+ *  encryption. Only one backend is built at a time, build once per backend
+ *  to compare them.
+ *
+ *  Only built with CRYPTO_HOST.
+ */
+
+#ifndef __AES_BENCH_H__
+#define __AES_BENCH_H__
+
+#if defined(CRYPTO_HOST)
+
+#include "Aes128.h"
+
+namespace lora {
+
+    class AesBench {
+        public:
+
+            /**
+             * Throughput of one run
+             */
+            typedef struct {
+                    uint32_t Size;          //!< Bytes per message
+                    uint32_t Iterations;    //!< Number of messages
+                    uint32_t BlockUs;       //!< Time of Encrypt on every block of the messages
+                    uint32_t CmacUs;        //!< Time of Cmac
+                    uint32_t CtrUs;         //!< Time of Ctr
+            } BenchResult;
+
+            /**
+             * Measure throughput of the block cipher and both modes
+             * @param size bytes per message
+             * @param iterations number of messages
+             */
+            static BenchResult Run(uint16_t size, uint32_t iterations);
+
+            /**
+             * Log a result at info level in MB/s
+             */
+            static void Report(const BenchResult& result);
+    };
+}
+
+#endif
+
+#endif // __AES_BENCH_H__
@@ -0,0 +1,115 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "Crc16Bench.h"
+#include "MTSLog.h"
+
+#if defined(CRYPTO_HOST)
+#include <chrono>
+#include <vector>
+
+using namespace lora;
+
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Crc16Bench::Check() {
+    static const uint8_t CHECK_DATA[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    std::vector<uint8_t> data(CRC16_BENCH_MAX_CHECK);
+    bool ret = true;
+
+    // CRC-16/XMODEM and CRC-16/CCITT-FALSE check values
+    if (Crc16::Compute(CHECK_DATA, sizeof(CHECK_DATA), CRC16_BEACON_INIT) != 0x31C3) {
+        logError("CRC16 check value with init 0x0000 mismatch");
+        ret = false;
+    }
+
+    if (Crc16::Compute(CHECK_DATA, sizeof(CHECK_DATA), CRC16_RECORD_INIT) != 0x29B1) {
+        logError("CRC16 check value with init 0xFFFF mismatch");
+        ret = false;
+    }
+
+    for (uint32_t i = 0; i < data.size(); i++) {
+        data[i] = (i * 151 + 17) & 0xFF;
+    }
+
+    for (uint32_t size = 0; size <= CRC16_BENCH_MAX_CHECK; size++) {
+        const uint8_t* p = data.empty() ? NULL : &data[0];
+
+        if (Crc16::Compute(p, size, CRC16_BEACON_INIT) != Bitwise(p, size, CRC16_BEACON_INIT)
+            || Crc16::Compute(p, size, CRC16_RECORD_INIT) != Bitwise(p, size, CRC16_RECORD_INIT)) {
+            logError("CRC16 mismatch with bitwise at %lu bytes", size);
+            ret = false;
+        }
+    }
+
+    return ret;
+}
+
+Crc16Bench::BenchResult Crc16Bench::Run(uint32_t size, uint32_t iterations) {
+    std::vector<uint8_t> data(size > 0 ? size : 1);
+    BenchResult result;
+    uint16_t table = CRC16_RECORD_INIT;
+    uint16_t bitwise = CRC16_RECORD_INIT;
+
+    for (uint32_t i = 0; i < data.size(); i++) {
+        data[i] = (i * 151 + 17) & 0xFF;
+    }
+
+    result.Size = size;
+    result.Iterations = iterations;
+
+    // Chain the CRCs so the loops are not optimized away
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        table = Crc16::Compute(&data[0], size, table);
+    }
+    result.TableUs = elapsedUs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        bitwise = Bitwise(&data[0], size, bitwise);
+    }
+    result.BitwiseUs = elapsedUs(start);
+
+    result.Match = table == bitwise;
+    return result;
+}
+
+void Crc16Bench::Report(const BenchResult& result) {
+    uint64_t bytes = (uint64_t) result.Size * result.Iterations;
+
+    logInfo("CRC16 %lu bytes x %lu table %lu MB/s bitwise %lu MB/s %s", result.Size, result.Iterations,
+            result.TableUs ? (uint32_t) (bytes / result.TableUs) : 0,
+            result.BitwiseUs ? (uint32_t) (bytes / result.BitwiseUs) : 0,
+            result.Match ? "match" : "MISMATCH");
+}
+
+uint16_t Crc16Bench::Bitwise(const uint8_t* data, size_t size, uint16_t crc) {
+    for (size_t i = 0; i < size; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+#endif
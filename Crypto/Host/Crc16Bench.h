@@ -0,0 +1,71 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::Crc16Bench checks and benchmarks lora::Crc16 on a host
+ *
+ * @details
+ *  Compares the table driven Crc16::Compute with a bitwise CRC-16 CCITT for
+ *  every buffer length up to CRC16_BENCH_MAX_CHECK and both initial values,
+ *  checks the standard check values of "123456789" and measures the throughput
+ *  of both on buffers of a given size.
+ *
+ *  Only built with CRYPTO_HOST.
+ */
+
+#ifndef __CRC16_BENCH_H__
+#define __CRC16_BENCH_H__
+
+#if defined(CRYPTO_HOST)
+
+#include "Crc16.h"
+
+namespace lora {
+
+    const uint16_t CRC16_BENCH_MAX_CHECK = 1024;    //!< Longest buffer compared with the bitwise CRC
+
+    class Crc16Bench {
+        public:
+
+            /**
+             * Throughput of one run
+             */
+            typedef struct {
+                    uint32_t Size;          //!< Bytes per buffer
+                    uint32_t Iterations;    //!< Number of buffers
+                    uint32_t TableUs;       //!< Time of Crc16::Compute
+                    uint32_t BitwiseUs;     //!< Time of the bitwise CRC
+                    bool Match;             //!< Both gave the same CRC
+            } BenchResult;
+
+            /**
+             * Check values and comparison with the bitwise CRC, failures are logged at error level
+             * @return true if all matched
+             */
+            static bool Check();
+
+            /**
+             * Measure throughput of the table and bitwise CRC
+             * @param size bytes per buffer
+             * @param iterations number of buffers
+             */
+            static BenchResult Run(uint32_t size, uint32_t iterations);
+
+            /**
+             * Log a result at info level in MB/s
+             */
+            static void Report(const BenchResult& result);
+
+            /**
+             * Bitwise CRC-16 CCITT, eight shift steps per byte
+             */
+            static uint16_t Bitwise(const uint8_t* data, size_t size, uint16_t crc);
+    };
+}
+
+#endif
+
+#endif // __CRC16_BENCH_H__
@@ -0,0 +1,234 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "CryptoKat.h"
+
+#if defined(CRYPTO_HOST)
+#include <chrono>
+#include <vector>
+
+using namespace lora;
+
+// FIPS-197 Appendix B and C.1
+static const uint8_t AES_KEY_B[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+static const uint8_t AES_IN_B[16] = { 0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34 };
+static const uint8_t AES_OUT_B[16] = { 0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32 };
+static const uint8_t AES_KEY_C1[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+static const uint8_t AES_IN_C1[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+static const uint8_t AES_OUT_C1[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+
+// RFC 4493 section 4, the key is the one of FIPS-197 Appendix B
+static const uint8_t CMAC_MSG[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+static const uint8_t CMAC_SIZES[4] = { 0, 16, 40, 64 };
+static const uint8_t CMAC_OUT[4][16] = {
+    { 0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46 },
+    { 0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c },
+    { 0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27 },
+    { 0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe }
+};
+
+// SP 800-38A F.5.1, the key is the one of FIPS-197 Appendix B and the plaintext the RFC 4493 message
+static const uint8_t CTR_COUNTER[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+static const uint8_t CTR_OUT[64] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+
+// LoRaWAN data frames, MIC and FRMPayload computed with OpenSSL CMAC and AES-128-ECB
+// from the B0 and A blocks of LoRaWAN 1.0.x sections 4.3.3 and 4.4
+static const uint8_t FRAME_NWK_SKEY[16] = { 0x44, 0x02, 0x42, 0x41, 0xed, 0x4c, 0xe9, 0xa6, 0x8c, 0x6a, 0x8b, 0xc0, 0x55, 0x23, 0x3f, 0xd3 };
+static const uint8_t FRAME_APP_SKEY[16] = { 0xec, 0x92, 0x58, 0x02, 0xae, 0x43, 0x0c, 0xa7, 0x7f, 0xd3, 0xdd, 0x73, 0xcb, 0x2c, 0xc5, 0x88 };
+
+// Unconfirmed uplink, DevAddr 49be7df1, FCnt 2, FPort 1, "test"
+static const uint32_t FRAME_UP_ADDRESS = 0x49be7df1;
+static const uint32_t FRAME_UP_COUNTER = 2;
+static const uint8_t FRAME_UP_PLAIN[4] = { 't', 'e', 's', 't' };
+static const uint8_t FRAME_UP[13] = { 0x40, 0xf1, 0x7d, 0xbe, 0x49, 0x00, 0x02, 0x00, 0x01, 0x95, 0x43, 0x78, 0x76 };
+static const uint32_t FRAME_UP_MIC = 0x0dff112b;
+
+// Unconfirmed downlink, DevAddr 26011bda, FCnt 0x00012345 with the upper 16 bits not sent, FPort 10
+static const uint32_t FRAME_DOWN_ADDRESS = 0x26011bda;
+static const uint32_t FRAME_DOWN_COUNTER = 0x00012345;
+static const uint8_t FRAME_DOWN_PLAIN[20] = { 'L', 'o', 'R', 'a', 'W', 'A', 'N', ' ', 't', 'e', 's', 't', ' ', 'v', 'e', 'c', 't', 'o', 'r', '!' };
+static const uint8_t FRAME_DOWN[29] = {
+    0x60, 0xda, 0x1b, 0x01, 0x26, 0x00, 0x45, 0x23, 0x0a,
+    0x9b, 0x8e, 0x4f, 0xa7, 0xcf, 0xe0, 0xaa, 0x8b, 0xb8, 0xdc, 0x0c, 0xda, 0xeb, 0x13, 0xd0, 0xa3, 0xb8, 0xe3, 0x10, 0x95
+};
+static const uint32_t FRAME_DOWN_MIC = 0xba072b22;
+
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint8_t CryptoKat::Run() {
+    uint8_t failed = Aes() + Cmac() + CmacB0() + Ctr() + Frame();
+
+    logInfo("Crypto known answer tests backend %d: %s", AES_BACKEND, failed ? "FAILED" : "passed");
+    return failed;
+}
+
+uint8_t CryptoKat::Aes() {
+    CryptoContext ctx;
+    uint8_t out[AES_BLOCK_SIZE];
+    uint8_t failed = 0;
+
+    ctx.SetKey(AES_KEY_B);
+    ctx.Encrypt(AES_IN_B, out);
+    failed += !Check("FIPS-197 B", out, AES_OUT_B, sizeof(out));
+
+    ctx.SetKey(AES_KEY_C1);
+    ctx.Encrypt(AES_IN_C1, out);
+    failed += !Check("FIPS-197 C.1", out, AES_OUT_C1, sizeof(out));
+
+    // In place
+    memcpy(out, AES_IN_C1, sizeof(out));
+    ctx.Encrypt(out, out);
+    failed += !Check("FIPS-197 C.1 in place", out, AES_OUT_C1, sizeof(out));
+
+    return failed;
+}
+
+uint8_t CryptoKat::Cmac() {
+    CryptoContext ctx;
+    uint8_t mac[AES_BLOCK_SIZE];
+    uint8_t failed = 0;
+
+    ctx.SetKey(AES_KEY_B);
+
+    for (uint8_t i = 0; i < sizeof(CMAC_SIZES); i++) {
+        ctx.Cmac(NULL, CMAC_MSG, CMAC_SIZES[i], mac);
+        failed += !Check("RFC 4493", mac, CMAC_OUT[i], sizeof(mac));
+    }
+
+    return failed;
+}
+
+uint8_t CryptoKat::CmacB0() {
+    CryptoContext ctx;
+    uint8_t whole[AES_BLOCK_SIZE + sizeof(CMAC_MSG)];
+    uint8_t expected[AES_BLOCK_SIZE];
+    uint8_t mac[AES_BLOCK_SIZE];
+    uint8_t failed = 0;
+
+    ctx.SetKey(AES_KEY_B);
+    memcpy(whole, AES_IN_C1, AES_BLOCK_SIZE);
+    memcpy(whole + AES_BLOCK_SIZE, CMAC_MSG, sizeof(CMAC_MSG));
+
+    for (uint8_t size = 0; size <= sizeof(CMAC_MSG); size++) {
+        ctx.Cmac(whole, whole + AES_BLOCK_SIZE, size, mac);
+        ctx.Cmac(NULL, whole, AES_BLOCK_SIZE + size, expected);
+        failed += !Check("CMAC B0", mac, expected, sizeof(mac));
+    }
+
+    return failed;
+}
+
+uint8_t CryptoKat::Ctr() {
+    Aes128 aes;
+    uint8_t counter[AES_BLOCK_SIZE];
+    uint8_t data[sizeof(CMAC_MSG)];
+    uint8_t failed = 0;
+
+    aes.SetKey(AES_KEY_B);
+
+    // The counter carries from the last byte into the one before it after the first block
+    memcpy(counter, CTR_COUNTER, sizeof(counter));
+    memcpy(data, CMAC_MSG, sizeof(data));
+    aes.Ctr(counter, data, sizeof(data));
+    failed += !Check("SP 800-38A F.5.1", data, CTR_OUT, sizeof(data));
+
+    memcpy(counter, CTR_COUNTER, sizeof(counter));
+    memcpy(data, CMAC_MSG, sizeof(data));
+    aes.Ctr(counter, data, 40);
+    failed += !Check("SP 800-38A F.5.1 partial", data, CTR_OUT, 40);
+    failed += !Check("SP 800-38A F.5.1 partial tail", data + 40, CMAC_MSG + 40, sizeof(data) - 40);
+
+    return failed;
+}
+
+uint8_t CryptoKat::Frame() {
+    CryptoContext nwk;
+    CryptoContext app;
+    uint8_t data[sizeof(FRAME_DOWN_PLAIN)];
+    uint8_t failed = 0;
+
+    nwk.SetKey(FRAME_NWK_SKEY);
+    app.SetKey(FRAME_APP_SKEY);
+
+    // FRMPayload starts after MHDR, FHDR without options and FPort
+    memcpy(data, FRAME_UP_PLAIN, sizeof(FRAME_UP_PLAIN));
+    app.Crypt(CRYPTO_UPLINK, FRAME_UP_ADDRESS, FRAME_UP_COUNTER, data, sizeof(FRAME_UP_PLAIN));
+    failed += !Check("LoRaWAN uplink FRMPayload", data, FRAME_UP + 9, sizeof(FRAME_UP_PLAIN));
+
+    if (nwk.ComputeMic(CRYPTO_UPLINK, FRAME_UP_ADDRESS, FRAME_UP_COUNTER, FRAME_UP, sizeof(FRAME_UP)) != FRAME_UP_MIC) {
+        logError("LoRaWAN uplink MIC mismatch");
+        failed++;
+    }
+
+    // Two keystream blocks, the second one partly used
+    memcpy(data, FRAME_DOWN + 9, sizeof(FRAME_DOWN_PLAIN));
+    app.Crypt(CRYPTO_DOWNLINK, FRAME_DOWN_ADDRESS, FRAME_DOWN_COUNTER, data, sizeof(FRAME_DOWN_PLAIN));
+    failed += !Check("LoRaWAN downlink FRMPayload", data, FRAME_DOWN_PLAIN, sizeof(FRAME_DOWN_PLAIN));
+
+    if (nwk.ComputeMic(CRYPTO_DOWNLINK, FRAME_DOWN_ADDRESS, FRAME_DOWN_COUNTER, FRAME_DOWN, sizeof(FRAME_DOWN)) != FRAME_DOWN_MIC) {
+        logError("LoRaWAN downlink MIC mismatch");
+        failed++;
+    }
+
+    return failed;
+}
+
+uint32_t CryptoKat::Time(uint8_t size, uint32_t frames) {
+    CryptoContext nwk;
+    CryptoContext app;
+    std::vector<uint8_t> frame(9 + size);
+    uint32_t mic = 0;
+
+    nwk.SetKey(FRAME_NWK_SKEY);
+    app.SetKey(FRAME_APP_SKEY);
+    memcpy(&frame[0], FRAME_UP, 9);
+
+    // Encrypt then MIC as for an uplink, the MIC is chained so the loop is not optimized away
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        frame[5] ^= mic & 0xFF;
+        app.Crypt(CRYPTO_UPLINK, FRAME_UP_ADDRESS, i, frame.data() + 9, size);
+        mic = nwk.ComputeMic(CRYPTO_UPLINK, FRAME_UP_ADDRESS, i, &frame[0], frame.size());
+    }
+    uint32_t us = elapsedUs(start);
+
+    logInfo("LoRaWAN frames backend %d %u bytes x %lu: %lu ns per frame mic %08lx", AES_BACKEND, size, frames,
+            frames ? (uint32_t) ((uint64_t) us * 1000 / frames) : 0, mic);
+    return us;
+}
+
+bool CryptoKat::Check(const char* name, const uint8_t* out, const uint8_t* expected, uint8_t size) {
+    if (memcmp(out, expected, size) == 0)
+        return true;
+
+    logError("%s mismatch", name);
+    return false;
+}
+
+#endif
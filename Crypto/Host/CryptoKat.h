@@ -0,0 +1,87 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::CryptoKat known answer tests of the crypto contexts for host builds
+ *
+ * @details
+ *  Checks the AES backend selected by AES_BACKEND against the FIPS-197 example
+ *  vectors, its CMAC mode against the RFC 4493 AES-CMAC vectors and its CTR mode
+ *  against the SP 800-38A CTR-AES128 example. The
+ *  B0 path of Cmac, used for frame MICs, is checked against CMAC over B0 and the
+ *  message in one buffer. ComputeMic and Crypt are checked on an uplink and a
+ *  downlink data frame, covering direction, address, 32-bit counter and the
+ *  length and block index bytes of the B0 and A blocks. Time measures frame MIC
+ *  and payload encryption. Build once per backend to compare them.
+ *
+ *  Only built with CRYPTO_HOST.
+ */
+
+#ifndef __CRYPTO_KAT_H__
+#define __CRYPTO_KAT_H__
+
+#if defined(CRYPTO_HOST)
+
+#include "CryptoContext.h"
+
+namespace lora {
+
+    class CryptoKat {
+        public:
+
+            /**
+             * Run all known answer tests, failures are logged at error level
+             * @return number of failed tests
+             */
+            static uint8_t Run();
+
+            /**
+             * Check the block cipher against FIPS-197 Appendix B and C.1
+             * @return number of failed vectors
+             */
+            static uint8_t Aes();
+
+            /**
+             * Check CMAC against the four examples of RFC 4493
+             * @return number of failed vectors
+             */
+            static uint8_t Cmac();
+
+            /**
+             * Check CMAC with a B0 block against CMAC of B0 and message concatenated
+             * @return number of failed message sizes
+             */
+            static uint8_t CmacB0();
+
+            /**
+             * Check CTR against SP 800-38A F.5.1, whole and partial last block
+             * @return number of failed vectors
+             */
+            static uint8_t Ctr();
+
+            /**
+             * Check ComputeMic and Crypt on an uplink and a downlink LoRaWAN data frame
+             * @return number of failed checks
+             */
+            static uint8_t Frame();
+
+            /**
+             * Measure MIC and payload encryption of data frames, logged at info level
+             * @param size bytes of frame payload
+             * @param frames number of frames
+             * @return time in us
+             */
+            static uint32_t Time(uint8_t size, uint32_t frames);
+
+        private:
+
+            static bool Check(const char* name, const uint8_t* out, const uint8_t* expected, uint8_t size);
+    };
+}
+
+#endif
+
+#endif // __CRYPTO_KAT_H__
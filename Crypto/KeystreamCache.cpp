@@ -0,0 +1,105 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "KeystreamCache.h"
+
+using namespace lora;
+
+static const uint8_t CRYPT_BLOCK = 0x01;
+
+KeystreamCache::KeystreamCache()
+:
+  _seq(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    Clear();
+}
+
+KeystreamCache::~KeystreamCache() {
+    Clear();
+}
+
+void KeystreamCache::Prepare(const CryptoContext& ctx, uint32_t address, uint32_t counter, uint16_t size) {
+    uint8_t a[AES_BLOCK_SIZE];
+    uint8_t slot = 0;
+
+    if (!ctx.IsValid())
+        return;
+
+    if (size > KEYSTREAM_MAX_SIZE)
+        size = KEYSTREAM_MAX_SIZE;
+
+    for (uint8_t i = 0; i < KEYSTREAM_SLOTS; i++) {
+        if (_slots[i].Size != 0 && _slots[i].Address == address) {
+            slot = i;
+            break;
+        }
+
+        if (_slots[i].Seq < _slots[slot].Seq)
+            slot = i;
+    }
+
+    Slot& s = _slots[slot];
+
+    // Already prepared, counter did not move since
+    if (s.Size >= size && s.Counter == counter && ctx.Matches(s.Key))
+        return;
+
+    memcpy(s.Key, ctx.GetKey(), KEY_SIZE);
+    s.Address = address;
+    s.Counter = counter;
+    s.Size = 0;
+    s.Seq = ++_seq;
+
+    for (uint16_t pos = 0; pos < size; pos += AES_BLOCK_SIZE) {
+        CryptoContext::FrameBlock(a, CRYPT_BLOCK, CRYPTO_DOWNLINK, address, counter, pos / AES_BLOCK_SIZE + 1);
+        ctx.Encrypt(a, &s.Stream[pos]);
+        s.Size = pos + AES_BLOCK_SIZE;
+    }
+
+    _stats.Prepared++;
+}
+
+bool KeystreamCache::Decrypt(const CryptoContext& ctx, uint32_t address, uint32_t counter, uint8_t* data, uint8_t size) {
+    for (uint8_t i = 0; i < KEYSTREAM_SLOTS; i++) {
+        Slot& s = _slots[i];
+
+        if (s.Size < size || s.Address != address || s.Counter != counter || !ctx.Matches(s.Key))
+            continue;
+
+        for (uint8_t j = 0; j < size; j++) {
+            data[j] ^= s.Stream[j];
+        }
+
+        // Keystream is never used twice
+        s.Size = 0;
+        _stats.Hits++;
+        return true;
+    }
+
+    ctx.Crypt(CRYPTO_DOWNLINK, address, counter, data, size);
+    _stats.Misses++;
+    return false;
+}
+
+void KeystreamCache::Clear() {
+    memset(_slots, 0, sizeof(_slots));
+}
+
+const KeystreamCache::KeystreamStats& KeystreamCache::GetStats() {
+    return _stats;
+}
@@ -0,0 +1,104 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::KeystreamCache precomputes downlink keystream for expected frame counters
+ *
+ * @details
+ *  Downlink payloads are encrypted with AES-CTR over blocks built from the address and
+ *  frame counter, both known before the frame arrives. Prepare computes the keystream
+ *  for the next expected counter while the MCU is otherwise idle, between TxDone and
+ *  RX1 or after handling a Class C or multicast frame, and Decrypt of a matching frame
+ *  is then only an XOR. Frames that were not prepared are decrypted normally.
+ */
+
+#ifndef __KEYSTREAM_CACHE_H__
+#define __KEYSTREAM_CACHE_H__
+
+#include "CryptoContext.h"
+
+namespace lora {
+
+#if defined(TARGET_XDOT_L151CC)
+    const uint8_t KEYSTREAM_SLOTS = 1;              //!< Number of address and counter pairs prepared
+    const uint16_t KEYSTREAM_MAX_SIZE = 64;         //!< Max payload bytes prepared per slot
+#else
+    const uint8_t KEYSTREAM_SLOTS = 2;              //!< Number of address and counter pairs prepared, unicast and one multicast group
+    const uint16_t KEYSTREAM_MAX_SIZE = 256;        //!< Max payload bytes prepared per slot, covers the largest payload
+#endif
+
+    class KeystreamCache {
+        public:
+
+            /**
+             * Keystream statistics
+             */
+            typedef struct {
+                    uint32_t Prepared;      //!< Number of slots prepared
+                    uint32_t Hits;          //!< Number of payloads decrypted from prepared keystream
+                    uint32_t Misses;        //!< Number of payloads decrypted without prepared keystream
+            } KeystreamStats;
+
+            /**
+             * KeystreamCache constructor
+             */
+            KeystreamCache();
+
+            /**
+             * KeystreamCache destructor, clears keystream
+             */
+            ~KeystreamCache();
+
+            /**
+             * Precompute downlink keystream for a frame counter
+             * Replaces the slot prepared for the same address, else the oldest slot
+             * @param ctx context of the payload key
+             * @param address device or multicast address
+             * @param counter next expected full 32-bit downlink counter
+             * @param size payload bytes to prepare, limited to KEYSTREAM_MAX_SIZE
+             */
+            void Prepare(const CryptoContext& ctx, uint32_t address, uint32_t counter, uint16_t size = KEYSTREAM_MAX_SIZE);
+
+            /**
+             * Decrypt a downlink payload in place
+             * Uses prepared keystream when key, address and counter match, the slot is consumed
+             * @param ctx context of the payload key
+             * @param address device or multicast address
+             * @param counter full 32-bit downlink counter of frame
+             * @param data payload
+             * @param size bytes in payload
+             * @return true if prepared keystream was used
+             */
+            bool Decrypt(const CryptoContext& ctx, uint32_t address, uint32_t counter, uint8_t* data, uint8_t size);
+
+            /**
+             * Discard all prepared keystream
+             */
+            void Clear();
+
+            /**
+             * Get keystream statistics
+             */
+            const KeystreamStats& GetStats();
+
+        private:
+
+            typedef struct {
+                    uint8_t Key[KEY_SIZE];                      //!< Payload key the stream was computed with
+                    uint32_t Address;
+                    uint32_t Counter;
+                    uint16_t Size;                              //!< Bytes prepared, 0 if slot is empty
+                    uint32_t Seq;                               //!< Prepare sequence for replacement
+                    uint8_t Stream[KEYSTREAM_MAX_SIZE];
+            } Slot;
+
+            Slot _slots[KEYSTREAM_SLOTS];
+            uint32_t _seq;
+            KeystreamStats _stats;
+    };
+}
+
+#endif // __KEYSTREAM_CACHE_H__
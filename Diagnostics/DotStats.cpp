@@ -0,0 +1,168 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "DotStats.h"
+#include "MTSLog.h"
+
+static const char* SUBSYSTEM_NAMES[] = { "mac", "plan", "fota", "rx", "app" };
+
+DotStats::time_scope::time_scope(subsystem sys)
+    : _sys(sys),
+      _start(us_ticker_read())
+{
+}
+
+DotStats::time_scope::~time_scope() {
+    DotStats::getInstance()->addTime(_sys, us_ticker_read() - _start);
+}
+
+DotStats::heap_scope::heap_scope(subsystem sys)
+    : _sys(sys),
+      _start(DotStats::heapInUse())
+{
+}
+
+DotStats::heap_scope::~heap_scope() {
+    sample();
+}
+
+void DotStats::heap_scope::sample() {
+    uint32_t now = DotStats::heapInUse();
+
+    DotStats::getInstance()->addHeapGrowth(_sys, now > _start ? now - _start : 0);
+}
+
+DotStats::DotStats() {
+    reset();
+}
+
+DotStats* DotStats::getInstance() {
+    static DotStats instance;
+    return &instance;
+}
+
+uint8_t DotStats::getThreadStacks(thread_stack* threads, uint8_t max) {
+#if defined(MBED_THREAD_STATS_ENABLED) && defined(MBED_STACK_STATS_ENABLED)
+    mbed_stats_thread_t stats[DOT_STATS_MAX_THREADS];
+    size_t count = mbed_stats_thread_get_each(stats, DOT_STATS_MAX_THREADS);
+
+    if (count > max)
+        count = max;
+
+    for (size_t i = 0; i < count; i++) {
+        // Thread stack space is the unused part below the watermark
+        threads[i].id = stats[i].id;
+        threads[i].name = stats[i].name ? stats[i].name : "";
+        threads[i].stack_size = stats[i].stack_size;
+        threads[i].stack_max = stats[i].stack_size - stats[i].stack_space;
+    }
+
+    return count;
+#else
+    (void) threads;
+    (void) max;
+    return 0;
+#endif
+}
+
+DotStats::time_stats DotStats::getTime(subsystem sys) {
+    time_stats stats;
+
+    core_util_critical_section_enter();
+    stats = _time[sys];
+    core_util_critical_section_exit();
+
+    return stats;
+}
+
+DotStats::heap_growth DotStats::getHeapGrowth(subsystem sys) {
+    heap_growth stats;
+
+    core_util_critical_section_enter();
+    stats = _heap[sys];
+    core_util_critical_section_exit();
+
+    return stats;
+}
+
+uint32_t DotStats::getHeapPeak() {
+#if defined(MBED_HEAP_STATS_ENABLED)
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    return heap.max_size;
+#else
+    return 0;
+#endif
+}
+
+void DotStats::addTime(subsystem sys, uint32_t us) {
+    if (sys >= NUM_SUBSYSTEMS)
+        return;
+
+    core_util_critical_section_enter();
+    _time[sys].calls++;
+    _time[sys].total_us += us;
+    if (us > _time[sys].max_us)
+        _time[sys].max_us = us;
+    core_util_critical_section_exit();
+}
+
+void DotStats::addHeapGrowth(subsystem sys, uint32_t bytes) {
+    if (sys >= NUM_SUBSYSTEMS)
+        return;
+
+    core_util_critical_section_enter();
+    _heap[sys].last_growth = bytes;
+    if (bytes > _heap[sys].max_growth)
+        _heap[sys].max_growth = bytes;
+    core_util_critical_section_exit();
+}
+
+void DotStats::reset() {
+    core_util_critical_section_enter();
+    memset(_time, 0, sizeof(_time));
+    memset(_heap, 0, sizeof(_heap));
+    core_util_critical_section_exit();
+}
+
+void DotStats::printStats() {
+    thread_stack threads[DOT_STATS_MAX_THREADS];
+    uint8_t count = getThreadStacks(threads, DOT_STATS_MAX_THREADS);
+
+    for (uint8_t i = 0; i < count; i++) {
+        logInfo("Thread %08lx %s stack %lu/%lu", threads[i].id, threads[i].name, threads[i].stack_max, threads[i].stack_size);
+    }
+
+    for (uint8_t i = 0; i < NUM_SUBSYSTEMS; i++) {
+        time_stats time = getTime((subsystem) i);
+        heap_growth heap = getHeapGrowth((subsystem) i);
+
+        logInfo("%s calls: %lu wall total: %lu us max: %lu us heap growth max: %lu", SUBSYSTEM_NAMES[i], time.calls, time.total_us, time.max_us, heap.max_growth);
+    }
+
+    logInfo("Heap peak %lu", getHeapPeak());
+}
+
+uint32_t DotStats::heapInUse() {
+#if defined(MBED_HEAP_STATS_ENABLED)
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    return heap.current_size;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,126 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _DOT_STATS_H
+#define _DOT_STATS_H
+#include "mbed.h"
+#include "mbed_stats.h"
+
+#define DOT_STATS_MAX_THREADS 8
+
+// Stack high-water marks, wall time and heap growth for sizing main-stack-size,
+// thread-stack-size and heap. Thread stacks are read from mbed thread stats and
+// need both MBED_THREAD_STATS_ENABLED and MBED_STACK_STATS_ENABLED, without stack
+// stats the RTOS does not watermark stacks and stack_space is not valid. Heap
+// figures need MBED_HEAP_STATS_ENABLED.
+//
+// With DOT_STATS defined the mac, plan, fota and rx paths built from source are wrapped
+// in DOT_STATS_TIME and DOT_STATS_HEAP, otherwise those expand to nothing. mDotEvent is
+// also compiled into the library so app time is recorded by the application, its
+// MacEvent override starts with DOT_STATS_TIME(SUBSYSTEM_APP) and DOT_STATS_HEAP(SUBSYSTEM_APP).
+// Time is wall time from entry to exit of the wrapped code and includes time spent
+// preempted by other threads and interrupts, the RTOS does not keep per-thread CPU
+// time. Heap figures are net growth across the wrapped code, memory allocated and
+// freed inside it is not seen.
+class DotStats {
+    public:
+        enum subsystem {
+            SUBSYSTEM_MAC,          // MAC answer planner
+            SUBSYSTEM_PLAN,         // channel selection
+            SUBSYSTEM_FOTA,         // fragment processing and decoding
+            SUBSYSTEM_RX,           // beacon decoding
+            SUBSYSTEM_APP,          // application MacEvent override
+            NUM_SUBSYSTEMS
+        };
+
+        typedef struct {
+            uint32_t id;
+            const char* name;
+            uint32_t stack_size;
+            uint32_t stack_max;             // high-water mark in bytes
+        } thread_stack;
+
+        typedef struct {
+            uint32_t calls;
+            uint32_t total_us;
+            uint32_t max_us;
+        } time_stats;
+
+        typedef struct {
+            uint32_t max_growth;            // largest net heap growth across a scope
+            uint32_t last_growth;           // net heap growth across last scope
+        } heap_growth;
+
+        // Measures wall time from construction to destruction
+        class time_scope {
+            public:
+                time_scope(subsystem sys);
+                ~time_scope();
+
+            private:
+                subsystem _sys;
+                uint32_t _start;
+        };
+
+        // Measures net heap growth from construction to destruction, sample() records growth so far
+        class heap_scope {
+            public:
+                heap_scope(subsystem sys);
+                ~heap_scope();
+                void sample();
+
+            private:
+                subsystem _sys;
+                uint32_t _start;
+        };
+
+        static DotStats* getInstance();
+
+        // Fill stack use of running threads, returns number of threads
+        uint8_t getThreadStacks(thread_stack* threads, uint8_t max);
+
+        time_stats getTime(subsystem sys);
+        heap_growth getHeapGrowth(subsystem sys);
+
+        // Peak heap in use since boot, 0 if heap stats are not enabled
+        uint32_t getHeapPeak();
+
+        void addTime(subsystem sys, uint32_t us);
+        void addHeapGrowth(subsystem sys, uint32_t bytes);
+        void reset();
+
+        // Log all figures at info level
+        void printStats();
+
+    private:
+        DotStats();
+
+        static uint32_t heapInUse();
+
+        time_stats _time[NUM_SUBSYSTEMS];
+        heap_growth _heap[NUM_SUBSYSTEMS];
+};
+
+#if defined(DOT_STATS)
+#define DOT_STATS_TIME(sys) DotStats::time_scope dot_stats_time(DotStats::sys)
+#define DOT_STATS_HEAP(sys) DotStats::heap_scope dot_stats_heap(DotStats::sys)
+#else
+#define DOT_STATS_TIME(sys)
+#define DOT_STATS_HEAP(sys)
+#endif
+
+#endif // _DOT_STATS_H
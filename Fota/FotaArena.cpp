@@ -0,0 +1,107 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FotaArena.h"
+#include <new>
+
+FotaArena::FotaArena()
+    : _memory(NULL),
+      _size(0),
+      _used(0),
+      _peak(0),
+      _owned(false)
+{
+}
+
+FotaArena::~FotaArena() {
+    release();
+}
+
+bool FotaArena::reserve(uint32_t size) {
+    release();
+
+    // Heap failure must not halt the node, the session is refused instead
+    _memory = new (std::nothrow) uint8_t[size];
+    if (_memory == NULL) {
+        logError("FOTA arena cannot reserve %lu bytes", size);
+        return false;
+    }
+
+    _size = size;
+    _owned = true;
+    return true;
+}
+
+void FotaArena::attach(uint8_t* memory, uint32_t size) {
+    release();
+
+    _memory = memory;
+    _size = memory != NULL ? size : 0;
+}
+
+void* FotaArena::alloc(uint32_t size) {
+    uint32_t offset = align(_used);
+
+    if (_memory == NULL || offset > _size || size > _size - offset)
+        return NULL;
+
+    _used = offset + size;
+    if (_used > _peak)
+        _peak = _used;
+
+    return _memory + offset;
+}
+
+uint32_t FotaArena::mark() {
+    return _used;
+}
+
+void FotaArena::rewind(uint32_t mark) {
+    if (mark < _used)
+        _used = mark;
+}
+
+void FotaArena::clear() {
+    _used = 0;
+}
+
+void FotaArena::release() {
+    if (_owned)
+        delete [] _memory;
+
+    _memory = NULL;
+    _size = 0;
+    _used = 0;
+    _peak = 0;
+    _owned = false;
+}
+
+uint8_t* FotaArena::getMemory() {
+    return _memory;
+}
+
+uint32_t FotaArena::getSize() {
+    return _size;
+}
+
+uint32_t FotaArena::getUsed() {
+    return _used;
+}
+
+uint32_t FotaArena::getPeak() {
+    return _peak;
+}
@@ -0,0 +1,72 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FOTA_ARENA_H
+#define _FOTA_ARENA_H
+#include "mDot.h"
+
+#define FOTA_ARENA_ALIGN 8
+
+// Bump allocator for memory that lives as long as a FOTA session. The memory is
+// reserved in one block when the session is set up so a session that does not fit
+// is refused at setup, objects are carved from it without per object heap blocks
+// and everything is given back at once when the session ends. Objects placed in
+// the arena are not destroyed, they must not own other resources.
+class FotaArena {
+    public:
+        FotaArena();
+        ~FotaArena();
+
+        // Reserve size bytes from the heap, fails if the heap has no such block
+        bool reserve(uint32_t size);
+
+        // Use memory owned by the caller
+        void attach(uint8_t* memory, uint32_t size);
+
+        // Allocate size bytes aligned to FOTA_ARENA_ALIGN, NULL if the arena is exhausted
+        void* alloc(uint32_t size);
+
+        // Current allocation point, rewind() frees everything allocated after it
+        uint32_t mark();
+        void rewind(uint32_t mark);
+
+        // Free all allocations, the memory stays reserved
+        void clear();
+
+        // Free all allocations and give reserved memory back to the heap, the peak starts over
+        void release();
+
+        uint8_t* getMemory();
+        uint32_t getSize();
+        uint32_t getUsed();
+        uint32_t getPeak();
+
+        static uint32_t align(uint32_t size) {
+            return (size + FOTA_ARENA_ALIGN - 1) & ~(uint32_t) (FOTA_ARENA_ALIGN - 1);
+        }
+
+    private:
+        FotaArena(const FotaArena&);
+        FotaArena& operator=(const FotaArena&);
+
+        uint8_t* _memory;
+        uint32_t _size;
+        uint32_t _used;
+        uint32_t _peak;
+        bool _owned;                    // memory was reserved from the heap
+};
+#endif // _FOTA_ARENA_H
@@ -0,0 +1,460 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FragmentationCheckpoint.h"
+#include "Crc16.h"
+
+#ifdef FOTA
+
+static const uint8_t CHECKPOINT_MAGIC = 0x46;
+static const uint8_t CHECKPOINT_VERSION = 1;
+static const uint8_t NO_COPY = 0xFF;
+static const uint8_t MAX_CHUNKS = 5;
+
+FragmentationCheckpoint::FragmentationCheckpoint(mDot* dot, uint8_t id, uint16_t interval)
+    : _dot(dot),
+      _id(id),
+      _interval(interval > 0 ? interval : 1),
+      _pending(0),
+      _solve_saved(false),
+      _complete(false),
+      _seq(0),
+      _copy(NO_COPY)
+{
+    _data.fd = -1;
+    snprintf(_data_name, sizeof(_data_name), FRAG_CHECKPOINT_DATA_FILE, id);
+    memset(&_opts, 0, sizeof(_opts));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+FragmentationCheckpoint::~FragmentationCheckpoint() {
+    close();
+}
+
+bool FragmentationCheckpoint::start(const frag_checkpoint_opts& opts) {
+    char name[32];
+
+    close();
+
+    for (uint8_t copy = 0; copy < 2; copy++) {
+        fileName(name, sizeof(name), copy);
+        _dot->deleteUserFile(name);
+    }
+
+    snprintf(name, sizeof(name), FRAG_CHECKPOINT_SOLVE_FILE, _id);
+    _dot->deleteUserFile(name);
+
+    _opts = opts;
+    _opts.last_frag_num = 0;
+    _opts.total_frags = 0;
+    _copy = NO_COPY;
+    _seq = 0;
+    _pending = 0;
+    _solve_saved = false;
+    _complete = false;
+
+    return openData(true);
+}
+
+bool FragmentationCheckpoint::load(frag_checkpoint_opts& opts) {
+    checkpoint_header header;
+    frag_checkpoint_opts copy_opts;
+
+    _copy = NO_COPY;
+
+    for (uint8_t copy = 0; copy < 2; copy++) {
+        if (!readCopy(copy, header, copy_opts))
+            continue;
+
+        if (_copy == NO_COPY || (int8_t)(header.seq - _seq) > 0) {
+            _copy = copy;
+            _seq = header.seq;
+            _opts = copy_opts;
+        }
+    }
+
+    if (_copy == NO_COPY)
+        return false;
+
+    opts = _opts;
+    return true;
+}
+
+bool FragmentationCheckpoint::restore(FragmentationDecoder* decoder) {
+    frag_checkpoint_opts opts;
+    checkpoint_header header;
+    decoder_state state;
+    char name[32];
+    bool ret;
+
+    if (_copy == NO_COPY && !load(opts))
+        return false;
+
+    memset(&state, 0, sizeof(state));
+
+    if (decoder->getFrameCount() != _opts.frame_count || decoder->getFrameSize() != _opts.frame_size)
+        return false;
+
+    fileName(name, sizeof(name), _copy);
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_RDONLY);
+    if (file.fd < 0)
+        return false;
+
+    uint16_t crc = lora::CRC16_RECORD_INIT;
+
+    ret = _dot->readUserFile(file, &header, sizeof(header)) == sizeof(header)
+        && readChunk(file, &opts, sizeof(opts), crc)
+        && readChunk(file, &state, sizeof(state), crc);
+
+    uint16_t rows = state.frozen ? state.lost : 0;
+    uint16_t words = (rows + 31) / 32;
+
+    if (ret && (rows > decoder->_max_lost || state.lost > decoder->_frame_count)) {
+        logError("Fragmentation checkpoint needs %u lost, decoder has %u", state.lost, decoder->_max_lost);
+        ret = false;
+    }
+
+    // Rows are stored with only the words their columns need
+    if (ret) {
+        memset(decoder->_pivots, 0, decoder->_row_words * 4);
+
+        ret = readChunk(file, decoder->_lost_map, decoder->_frame_words * 4, crc)
+            && readChunk(file, decoder->_lost_frames, rows * 2, crc)
+            && readChunk(file, decoder->_pivots, words * 4, crc);
+
+        for (uint16_t r = 0; r < rows && ret; r++) {
+            uint32_t* row = &decoder->_matrix[r * decoder->_row_words];
+
+            memset(row, 0, decoder->_row_words * 4);
+            ret = readChunk(file, row, words * 4, crc);
+        }
+    }
+
+    _dot->closeUserFile(file);
+
+    if (!ret || crc != header.crc) {
+        logError("Fragmentation checkpoint %u could not be restored", _id);
+        decoder->reset();
+        return false;
+    }
+
+    decoder->_lost = state.lost;
+    decoder->_filled = state.filled;
+    decoder->_solve_row = state.solve_row;
+    decoder->_frozen = state.frozen;
+    decoder->_state = (FragmentationDecoder::frag_state) state.state;
+
+    if (!openData(false)) {
+        decoder->reset();
+        return false;
+    }
+
+    attach(decoder);
+    _pending = 0;
+    _solve_saved = decoder->_state == FragmentationDecoder::STATE_SOLVING;
+    _complete = decoder->_state == FragmentationDecoder::STATE_COMPLETE;
+
+    if (_solve_saved)
+        replaySolve(decoder);
+
+    logInfo("Fragmentation session %u resumed, %u of %u lost, %u rows held", _id, decoder->_lost, decoder->_frame_count, decoder->_filled);
+    return true;
+}
+
+void FragmentationCheckpoint::attach(FragmentationDecoder* decoder) {
+    decoder->setFile(_dot, &_data);
+    decoder->setCheckpoint(this);
+}
+
+bool FragmentationCheckpoint::update(FragmentationDecoder* decoder, uint16_t index) {
+    if (index > _opts.last_frag_num)
+        _opts.last_frag_num = index;
+    _opts.total_frags++;
+
+    // Later fragments of a complete session change nothing
+    if (_complete)
+        return true;
+
+    if (decoder->_state != FragmentationDecoder::STATE_COMPLETE && ++_pending < _interval)
+        return true;
+
+    return save(decoder);
+}
+
+bool FragmentationCheckpoint::solving(FragmentationDecoder* decoder, uint16_t row, const uint8_t* data) {
+    solve_record record;
+    char name[32];
+
+    if (!_solve_saved && !save(decoder))
+        return false;
+
+    if (!decoder->readFrame(decoder->_lost_frames[row], decoder->_temp))
+        return false;
+
+    record.row = row;
+    record.crc_before = lora::Crc16::Compute(decoder->_temp, decoder->_frame_size, lora::CRC16_RECORD_INIT);
+    record.crc_after = lora::Crc16::Compute(data, decoder->_frame_size, lora::CRC16_RECORD_INIT);
+    record.crc = lora::Crc16::Compute((const uint8_t*) &record, offsetof(solve_record, crc), lora::CRC16_RECORD_INIT);
+
+    snprintf(name, sizeof(name), FRAG_CHECKPOINT_SOLVE_FILE, _id);
+    if (!_dot->appendUserFile(name, &record, sizeof(record))) {
+        _stats.errors++;
+        return false;
+    }
+
+    _stats.bytes_written += sizeof(record);
+    return true;
+}
+
+bool FragmentationCheckpoint::save(FragmentationDecoder* decoder) {
+    decoder_state state;
+    checkpoint_header header;
+    chunk list[MAX_CHUNKS];
+    char name[32];
+    bool ret;
+
+    state.lost = decoder->_lost;
+    state.filled = decoder->_filled;
+    state.solve_row = decoder->_solve_row;
+    state.frozen = decoder->_frozen;
+    state.state = decoder->_state;
+
+    uint8_t count = chunks(decoder, state, list);
+    uint16_t rows = state.frozen ? state.lost : 0;
+    uint16_t words = (rows + 31) / 32;
+
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.id = _id;
+    header.seq = (_copy == NO_COPY) ? 0 : _seq + 1;
+    header.length = 0;
+    header.crc = lora::CRC16_RECORD_INIT;
+    header.reserved = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        header.crc = lora::Crc16::Compute((const uint8_t*) list[i].data, list[i].size, header.crc);
+        header.length += list[i].size;
+    }
+
+    for (uint16_t r = 0; r < rows; r++) {
+        header.crc = lora::Crc16::Compute((const uint8_t*) &decoder->_matrix[r * decoder->_row_words], words * 4, header.crc);
+        header.length += words * 4;
+    }
+
+    // Write the older copy, the newest stays valid if this write fails
+    uint8_t copy = (_copy == 0) ? 1 : 0;
+
+    fileName(name, sizeof(name), copy);
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_WRONLY | mDot::FM_CREAT | mDot::FM_TRUNC);
+    if (file.fd < 0) {
+        _stats.errors++;
+        return false;
+    }
+
+    ret = _dot->writeUserFile(file, &header, sizeof(header)) == sizeof(header);
+
+    for (uint8_t i = 0; i < count && ret; i++)
+        ret = _dot->writeUserFile(file, (void*) list[i].data, list[i].size) == (int) list[i].size;
+
+    for (uint16_t r = 0; r < rows && ret; r++)
+        ret = _dot->writeUserFile(file, &decoder->_matrix[r * decoder->_row_words], words * 4) == words * 4;
+
+    _dot->closeUserFile(file);
+
+    if (!ret) {
+        logError("Fragmentation checkpoint %u write failed", _id);
+        _stats.errors++;
+        return false;
+    }
+
+    _copy = copy;
+    _seq = header.seq;
+    _pending = 0;
+    _complete = state.state == FragmentationDecoder::STATE_COMPLETE;
+    _stats.saves++;
+    _stats.bytes_written += sizeof(header) + header.length;
+
+    // Rows logged so far are covered by the new checkpoint
+    snprintf(name, sizeof(name), FRAG_CHECKPOINT_SOLVE_FILE, _id);
+    _dot->deleteUserFile(name);
+    _solve_saved = state.state == FragmentationDecoder::STATE_SOLVING;
+
+    logDebug("Fragmentation checkpoint %u seq %u %lu bytes", _id, _seq, header.length);
+    return true;
+}
+
+bool FragmentationCheckpoint::clear() {
+    char name[32];
+    bool ret = true;
+
+    close();
+
+    for (uint8_t copy = 0; copy < 2; copy++) {
+        fileName(name, sizeof(name), copy);
+        _dot->deleteUserFile(name);
+    }
+
+    snprintf(name, sizeof(name), FRAG_CHECKPOINT_SOLVE_FILE, _id);
+    _dot->deleteUserFile(name);
+    ret = _dot->deleteUserFile(_data_name);
+
+    _copy = NO_COPY;
+    return ret;
+}
+
+void FragmentationCheckpoint::close() {
+    if (_data.fd >= 0)
+        _dot->closeUserFile(_data);
+
+    _data.fd = -1;
+}
+
+const char* FragmentationCheckpoint::getDataName() {
+    return _data_name;
+}
+
+FragmentationCheckpoint::frag_checkpoint_opts FragmentationCheckpoint::getOpts() {
+    return _opts;
+}
+
+FragmentationCheckpoint::frag_checkpoint_stats FragmentationCheckpoint::getStats() {
+    return _stats;
+}
+
+uint8_t FragmentationCheckpoint::chunks(FragmentationDecoder* decoder, const decoder_state& state, chunk* out) {
+    uint16_t rows = state.frozen ? state.lost : 0;
+
+    out[0].data = &_opts;
+    out[0].size = sizeof(_opts);
+    out[1].data = &state;
+    out[1].size = sizeof(state);
+    out[2].data = decoder->_lost_map;
+    out[2].size = decoder->_frame_words * 4;
+    out[3].data = decoder->_lost_frames;
+    out[3].size = rows * 2;
+    out[4].data = decoder->_pivots;
+    out[4].size = ((rows + 31) / 32) * 4;
+
+    return MAX_CHUNKS;
+}
+
+bool FragmentationCheckpoint::readCopy(uint8_t copy, checkpoint_header& header, frag_checkpoint_opts& opts) {
+    uint8_t buffer[32];
+    char name[32];
+    bool ret;
+
+    fileName(name, sizeof(name), copy);
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_RDONLY);
+    if (file.fd < 0)
+        return false;
+
+    uint16_t crc = lora::CRC16_RECORD_INIT;
+
+    ret = _dot->readUserFile(file, &header, sizeof(header)) == sizeof(header)
+        && header.magic == CHECKPOINT_MAGIC
+        && header.version == CHECKPOINT_VERSION
+        && header.id == _id
+        && header.length >= sizeof(opts)
+        && readChunk(file, &opts, sizeof(opts), crc);
+
+    // Whole checkpoint is checked so load() never picks a torn copy
+    for (uint32_t left = ret ? header.length - sizeof(opts) : 0; left > 0 && ret; ) {
+        uint32_t size = left < sizeof(buffer) ? left : sizeof(buffer);
+
+        ret = readChunk(file, buffer, size, crc);
+        left -= size;
+    }
+
+    _dot->closeUserFile(file);
+    return ret && crc == header.crc;
+}
+
+bool FragmentationCheckpoint::readChunk(mDot::mdot_file& file, void* data, uint32_t size, uint16_t& crc) {
+    if (size == 0)
+        return true;
+
+    if (_dot->readUserFile(file, data, size) != (int) size)
+        return false;
+
+    crc = lora::Crc16::Compute((const uint8_t*) data, size, crc);
+    return true;
+}
+
+bool FragmentationCheckpoint::openData(bool create) {
+    int mode = mDot::FM_RDWR | mDot::FM_CREAT;
+
+    close();
+
+    if (create)
+        mode |= mDot::FM_TRUNC;
+
+    _data = _dot->openUserFile(_data_name, mode);
+    if (_data.fd < 0) {
+        logError("Failed to open fragment file %s", _data_name);
+        return false;
+    }
+
+    return true;
+}
+
+void FragmentationCheckpoint::replaySolve(FragmentationDecoder* decoder) {
+    solve_record record;
+    solve_record last;
+    bool logged = false;
+    char name[32];
+
+    snprintf(name, sizeof(name), FRAG_CHECKPOINT_SOLVE_FILE, _id);
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_RDONLY);
+    if (file.fd < 0)
+        return;
+
+    // A row logged before a lower one was written, rows in between had nothing to recover
+    while (_dot->readUserFile(file, &record, sizeof(record)) == sizeof(record)) {
+        if (record.crc != lora::Crc16::Compute((const uint8_t*) &record, offsetof(solve_record, crc), lora::CRC16_RECORD_INIT))
+            break;
+        if (record.row >= decoder->_solve_row || (logged && record.row > last.row))
+            break;
+
+        // Same row again is a retry after a failed write
+        if (logged && record.row < last.row)
+            decoder->_solve_row = last.row;
+
+        last = record;
+        logged = true;
+    }
+
+    _dot->closeUserFile(file);
+
+    if (!logged || !decoder->readFrame(decoder->_lost_frames[last.row], decoder->_temp))
+        return;
+
+    // Last logged row may or may not have been written before the reset
+    uint16_t crc = lora::Crc16::Compute(decoder->_temp, decoder->_frame_size, lora::CRC16_RECORD_INIT);
+
+    if (crc == last.crc_after) {
+        decoder->_solve_row = last.row;
+    } else if (crc != last.crc_before) {
+        logError("Fragmentation session %u row %u is neither reduced nor recovered", _id, last.row);
+        decoder->_state = FragmentationDecoder::STATE_FAILED;
+    }
+}
+
+void FragmentationCheckpoint::fileName(char* name, uint8_t size, uint8_t copy) {
+    snprintf(name, size, FRAG_CHECKPOINT_FILE, _id, 'a' + copy);
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAGMENTATION_CHECKPOINT_H
+#define _FRAGMENTATION_CHECKPOINT_H
+#include "mDot.h"
+#ifdef FOTA
+#include "FragmentationDecoder.h"
+
+#define FRAG_CHECKPOINT_FILE "frag_ckpt_%u_%c"
+#define FRAG_CHECKPOINT_DATA_FILE "frag_data_%u"
+#define FRAG_CHECKPOINT_SOLVE_FILE "frag_solve_%u"
+#define FRAG_CHECKPOINT_INTERVAL 16     // fragments between checkpoints
+
+// Lets a fragmentation session survive a reset or brown out. Fragments are kept in a
+// user file that is not recreated at boot, and the decoder state is saved next to it:
+// session options, the lost fragment map, the reduced parity rows and the solve position.
+// Checkpoints are A/B copies with a sequence number and CRC, a failed write leaves the
+// previous copy intact. Fragments received after the last checkpoint are received again.
+//
+// Solving replaces reduced data with recovered data in place, so it cannot be redone
+// from an older checkpoint. The state is saved when solving starts and each row is
+// logged with the CRC of its data before and after, restore() then knows whether the
+// last logged row was written.
+class FragmentationCheckpoint {
+    public:
+        typedef struct {
+            uint16_t frame_count;
+            uint8_t frame_size;
+            uint8_t padding;
+            uint16_t max_lost;
+            uint16_t last_frag_num;         // highest fragment index received
+            uint32_t total_frags;           // fragments received
+            uint32_t descriptor;
+        } frag_checkpoint_opts;
+
+        typedef struct {
+            uint32_t saves;
+            uint32_t bytes_written;
+            uint32_t errors;
+        } frag_checkpoint_stats;
+
+        FragmentationCheckpoint(mDot* dot, uint8_t id, uint16_t interval = FRAG_CHECKPOINT_INTERVAL);
+        ~FragmentationCheckpoint();
+
+        // Start a new session, clears any stored checkpoint and creates an empty fragment file
+        bool start(const frag_checkpoint_opts& opts);
+
+        // Read the options of the stored session
+        // returns true if a valid checkpoint was found
+        bool load(frag_checkpoint_opts& opts);
+
+        // Open the fragment file of the stored session and restore a decoder created
+        // for its options, the decoder is attached to the file and this checkpoint
+        bool restore(FragmentationDecoder* decoder);
+
+        // Use the fragment file and this checkpoint for a decoder of a started session
+        void attach(FragmentationDecoder* decoder);
+
+        // Called by the decoder after a fragment is processed, saves every interval fragments
+        bool update(FragmentationDecoder* decoder, uint16_t index);
+
+        // Called by the decoder before a recovered row is written
+        bool solving(FragmentationDecoder* decoder, uint16_t row, const uint8_t* data);
+
+        // Save the decoder state now
+        bool save(FragmentationDecoder* decoder);
+
+        // Remove the checkpoint and the fragment file, call once the session is done with
+        // the fragments, close() first to keep the fragment file
+        bool clear();
+
+        // Close the fragment file, keeping it and the checkpoint
+        void close();
+
+        // Name of the fragment file, to move the completed image for upgrade
+        const char* getDataName();
+
+        frag_checkpoint_opts getOpts();
+        frag_checkpoint_stats getStats();
+
+    private:
+        typedef struct {
+            uint8_t magic;
+            uint8_t version;                // layout version of the checkpoint
+            uint8_t id;
+            uint8_t seq;
+            uint32_t length;                // bytes following the header
+            uint16_t crc;
+            uint16_t reserved;
+        } checkpoint_header;
+
+        typedef struct {
+            uint16_t lost;
+            uint16_t filled;
+            uint16_t solve_row;
+            uint8_t frozen;
+            uint8_t state;
+        } decoder_state;
+
+        typedef struct {
+            uint16_t row;
+            uint16_t crc_before;
+            uint16_t crc_after;
+            uint16_t crc;
+        } solve_record;
+
+        typedef struct {
+            const void* data;
+            uint32_t size;
+        } chunk;
+
+        uint8_t chunks(FragmentationDecoder* decoder, const decoder_state& state, chunk* out);
+        bool readCopy(uint8_t copy, checkpoint_header& header, frag_checkpoint_opts& opts);
+        bool readChunk(mDot::mdot_file& file, void* data, uint32_t size, uint16_t& crc);
+        bool openData(bool create);
+        void replaySolve(FragmentationDecoder* decoder);
+        void fileName(char* name, uint8_t size, uint8_t copy);
+
+        mDot* _dot;
+        uint8_t _id;
+        uint16_t _interval;
+        uint16_t _pending;                  // fragments processed since the last checkpoint
+        bool _solve_saved;                  // state was saved when solving started
+        bool _complete;                     // final state was saved
+        uint8_t _seq;
+        uint8_t _copy;                      // newest stored copy, 0xFF if none
+        char _data_name[16];
+        mDot::mdot_file _data;
+        frag_checkpoint_opts _opts;
+        frag_checkpoint_stats _stats;
+};
+#endif
+#endif // _FRAGMENTATION_CHECKPOINT_H
@@ -0,0 +1,489 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FragmentationDecoder.h"
+#include "FragmentationCheckpoint.h"
+#include <new>
+
+#ifdef FOTA
+
+static uint32_t align4(uint32_t size) {
+    return (size + 3) & ~3UL;
+}
+
+static void xorBytes(uint8_t* dst, const uint8_t* src, uint8_t size) {
+    for (uint8_t i = 0; i < size; i++)
+        dst[i] ^= src[i];
+}
+
+uint32_t FragmentationDecoder::workspaceSize(uint16_t frame_count, uint8_t frame_size, uint16_t max_lost) {
+    uint32_t row_words = (max_lost + 31) / 32;
+    uint32_t frame_words = (frame_count + 31) / 32;
+
+    return frame_words * 4                      // lost map
+           + align4(max_lost * 2)               // lost fragment of each column
+           + max_lost * row_words * 4           // matrix
+           + row_words * 4 * 2                  // pivots and row being reduced
+           + frame_words * 4                    // parity matrix row
+           + align4(frame_size) * 2;            // fragment data and temp
+}
+
+uint16_t FragmentationDecoder::maxLost(uint16_t frame_count, uint8_t frame_size, uint32_t size) {
+    uint16_t lo = 0;
+    uint16_t hi = frame_count < MAX_PARITY ? frame_count : MAX_PARITY;
+
+    if (workspaceSize(frame_count, frame_size, 0) > size)
+        return 0;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi + 1) / 2;
+
+        if (workspaceSize(frame_count, frame_size, mid) <= size)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+uint32_t FragmentationDecoder::arenaSize(uint16_t frame_count, uint8_t frame_size, uint16_t max_lost) {
+    return FotaArena::align(sizeof(FragmentationDecoder)) + workspaceSize(frame_count, frame_size, max_lost);
+}
+
+FragmentationDecoder* FragmentationDecoder::create(FotaArena& arena, WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint16_t max_lost) {
+    uint32_t mark = arena.mark();
+    void* decoder = arena.alloc(sizeof(FragmentationDecoder));
+    uint8_t* workspace = (uint8_t*) arena.alloc(workspaceSize(frame_count, frame_size, max_lost));
+
+    if (decoder == NULL || workspace == NULL) {
+        arena.rewind(mark);
+        return NULL;
+    }
+
+    return new (decoder) FragmentationDecoder(fh, frame_count, frame_size, max_lost, workspace);
+}
+
+FragmentationDecoder::FragmentationDecoder(WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint16_t max_lost, uint8_t* workspace)
+    : _fh(fh),
+      _dot(NULL),
+      _file(NULL),
+      _checkpoint(NULL),
+      _cache(NULL),
+      _frame_count(frame_count),
+      _frame_size(frame_size),
+      _max_lost(max_lost),
+      _row_words((max_lost + 31) / 32),
+      _frame_words((frame_count + 31) / 32)
+{
+    uint8_t* p = workspace;
+
+    _lost_map = (uint32_t*) p;
+    p += _frame_words * 4;
+    _lost_frames = (uint16_t*) p;
+    p += align4(max_lost * 2);
+    _matrix = (uint32_t*) p;
+    p += max_lost * _row_words * 4;
+    _pivots = (uint32_t*) p;
+    p += _row_words * 4;
+    _row = (uint32_t*) p;
+    p += _row_words * 4;
+    _coeffs = (uint32_t*) p;
+    p += _frame_words * 4;
+    _data = p;
+    p += align4(frame_size);
+    _temp = p;
+
+    reset();
+}
+
+void FragmentationDecoder::reset() {
+    uint16_t words = _frame_words;
+
+    memset(_lost_map, 0xFF, words * 4);
+    if (_frame_count % 32)
+        _lost_map[words - 1] = (1UL << (_frame_count % 32)) - 1;
+
+    memset(_pivots, 0, _row_words * 4);
+    memset(&_stats, 0, sizeof(_stats));
+
+    _lost = _frame_count;
+    _filled = 0;
+    _solve_row = 0;
+    _frozen = false;
+    _state = _frame_count == 0 ? STATE_COMPLETE : STATE_RECEIVING;
+}
+
+void FragmentationDecoder::setFile(mDot* dot, mDot::mdot_file* file) {
+    _dot = dot;
+    _file = file;
+}
+
+void FragmentationDecoder::setCheckpoint(FragmentationCheckpoint* checkpoint) {
+    _checkpoint = checkpoint;
+}
+
+void FragmentationDecoder::setRowCache(FragmentationRowCache* cache) {
+    _cache = cache;
+}
+
+FragmentationDecoder::frag_status FragmentationDecoder::processFrame(uint16_t index, const uint8_t* data, uint8_t size) {
+    frag_status status = process(index, data, size);
+
+    // A failed checkpoint leaves the previous one, the fragment itself was processed
+    if (_checkpoint != NULL && (status == FRAG_DECODER_OK || status == FRAG_DECODER_COMPLETE))
+        _checkpoint->update(this, index);
+
+    return status;
+}
+
+FragmentationDecoder::frag_status FragmentationDecoder::process(uint16_t index, const uint8_t* data, uint8_t size) {
+    if (_state == STATE_COMPLETE)
+        return FRAG_DECODER_COMPLETE;
+    if (_state == STATE_FAILED)
+        return FRAG_DECODER_TOO_MANY_LOST;
+    if (_state == STATE_SOLVING || index == 0)
+        return FRAG_DECODER_OK;
+
+    if (size != _frame_size)
+        return FRAG_DECODER_SIZE_INCORRECT;
+
+    _stats.frames++;
+
+    if (index <= _frame_count) {
+        uint16_t frame = index - 1;
+
+        if (!isLost(frame))
+            return FRAG_DECODER_OK;
+
+        if (!_frozen) {
+            if (!writeFrame(frame, data))
+                return FRAG_DECODER_FLASH_ERROR;
+
+            _lost_map[frame / 32] &= ~(1UL << (frame % 32));
+            if (--_lost == 0) {
+                _state = STATE_COMPLETE;
+                return FRAG_DECODER_COMPLETE;
+            }
+
+            return FRAG_DECODER_OK;
+        }
+
+        // Lost set is fixed, a late uncoded fragment is a row with a single column
+        uint16_t col = lostRank(frame);
+
+        memset(_row, 0, _row_words * 4);
+        _row[col / 32] = 1UL << (col % 32);
+        memcpy(_data, data, _frame_size);
+    } else {
+        uint16_t base = 0;
+
+        _stats.coded++;
+
+        if (!_frozen)
+            freeze();
+        if (_state == STATE_FAILED)
+            return FRAG_DECODER_TOO_MANY_LOST;
+
+        const uint32_t* coeffs = parityRow(index - _frame_count);
+
+        memset(_row, 0, _row_words * 4);
+        memcpy(_data, data, _frame_size);
+
+        // Remove received fragments from the coded data, keep lost ones as matrix columns
+        for (uint16_t w = 0; w < _frame_words; w++) {
+            uint32_t lost = _lost_map[w];
+            uint32_t known = coeffs[w] & ~lost;
+            uint32_t cols = coeffs[w] & lost;
+
+            while (known != 0) {
+                if (!readFrame(w * 32 + __builtin_ctz(known), _temp))
+                    return FRAG_DECODER_FLASH_ERROR;
+                xorBytes(_data, _temp, _frame_size);
+                known &= known - 1;
+            }
+
+            // Column of a lost fragment is the number of lost fragments before it
+            while (cols != 0) {
+                uint8_t bit = __builtin_ctz(cols);
+                uint16_t col = base + __builtin_popcount(lost & ((1UL << bit) - 1));
+
+                _row[col / 32] |= 1UL << (col % 32);
+                cols &= cols - 1;
+            }
+
+            base += __builtin_popcount(lost);
+        }
+    }
+
+    return reduce();
+}
+
+FragmentationDecoder::frag_status FragmentationDecoder::solve(uint16_t rows) {
+    if (_state == STATE_COMPLETE)
+        return FRAG_DECODER_COMPLETE;
+    if (_state == STATE_FAILED)
+        return FRAG_DECODER_TOO_MANY_LOST;
+    if (_state != STATE_SOLVING)
+        return FRAG_DECODER_OK;
+
+    // Back substitution, rows below the current one already hold recovered fragments
+    while (rows-- > 0 && _solve_row > 0) {
+        uint16_t r = _solve_row - 1;
+        const uint32_t* row = &_matrix[r * _row_words];
+        bool loaded = false;
+
+        for (uint16_t w = r / 32; w < _row_words; w++) {
+            uint32_t bits = row[w];
+
+            if (w == r / 32)
+                bits &= (r % 32 == 31) ? 0 : (0xFFFFFFFFUL << (r % 32 + 1));
+
+            while (bits != 0) {
+                uint16_t j = w * 32 + __builtin_ctz(bits);
+
+                bits &= bits - 1;
+
+                if (!loaded) {
+                    if (!readFrame(_lost_frames[r], _data))
+                        return FRAG_DECODER_FLASH_ERROR;
+                    loaded = true;
+                }
+
+                if (!readFrame(_lost_frames[j], _temp))
+                    return FRAG_DECODER_FLASH_ERROR;
+                xorBytes(_data, _temp, _frame_size);
+            }
+        }
+
+        // Recovered data replaces the reduced data in place, the checkpoint logs the row first
+        if (loaded && _checkpoint != NULL && !_checkpoint->solving(this, r, _data))
+            return FRAG_DECODER_FLASH_ERROR;
+
+        if (loaded && !writeFrame(_lost_frames[r], _data))
+            return FRAG_DECODER_FLASH_ERROR;
+
+        _solve_row = r;
+    }
+
+    if (_solve_row == 0) {
+        _state = STATE_COMPLETE;
+        if (_checkpoint != NULL)
+            _checkpoint->save(this);
+        return FRAG_DECODER_COMPLETE;
+    }
+
+    return FRAG_DECODER_OK;
+}
+
+FragmentationDecoder::frag_state FragmentationDecoder::getState() {
+    return _state;
+}
+
+uint16_t FragmentationDecoder::getFrameCount() {
+    return _frame_count;
+}
+
+uint8_t FragmentationDecoder::getFrameSize() {
+    return _frame_size;
+}
+
+uint16_t FragmentationDecoder::getMaxLost() {
+    return _max_lost;
+}
+
+uint16_t FragmentationDecoder::getLost() {
+    return _lost;
+}
+
+uint16_t FragmentationDecoder::getNeeded() {
+    return _state == STATE_RECEIVING ? _lost - _filled : 0;
+}
+
+uint16_t FragmentationDecoder::getSolveLeft() {
+    return _state == STATE_SOLVING ? _solve_row : 0;
+}
+
+FragmentationDecoder::frag_decoder_stats FragmentationDecoder::getStats() {
+    return _stats;
+}
+
+int FragmentationDecoder::prbs23(int x) {
+    int b0 = x & 1;
+    int b1 = (x & 0x20) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+void FragmentationDecoder::parityMatrixRow(uint16_t n, uint16_t m, uint32_t* row) {
+    uint32_t x = 1 + 1001 * n;
+    uint32_t d = m + ((m & (m - 1)) == 0 ? 1 : 0);
+
+    memset(row, 0, ((m + 31) / 32) * 4);
+
+    if (m < 2)
+        return;
+
+    // Modulo by multiplying with the reciprocal, the quotient is at most one short
+    uint32_t inv = 0xFFFFFFFFUL / d;
+
+    for (uint16_t coeffs = 0; coeffs < m / 2; coeffs++) {
+        uint32_t r;
+
+        do {
+            x = prbs23(x);
+            r = x - (uint32_t) (((uint64_t) x * inv) >> 32) * d;
+            if (r >= d)
+                r -= d;
+        } while (r >= m);
+
+        row[r / 32] |= 1UL << (r % 32);
+    }
+}
+
+bool FragmentationDecoder::isLost(uint16_t frame) {
+    return (_lost_map[frame / 32] >> (frame % 32)) & 1;
+}
+
+uint16_t FragmentationDecoder::lostRank(uint16_t frame) {
+    uint16_t rank = 0;
+
+    for (uint16_t w = 0; w < frame / 32; w++)
+        rank += __builtin_popcount(_lost_map[w]);
+
+    return rank + __builtin_popcount(_lost_map[frame / 32] & ((1UL << (frame % 32)) - 1));
+}
+
+const uint32_t* FragmentationDecoder::parityRow(uint16_t n) {
+    // The cache may have been handed to a session with another fragment count
+    if (_cache != NULL && _cache->getFrameCount() == _frame_count) {
+        const uint32_t* cached = _cache->find(n);
+
+        if (cached != NULL) {
+            _stats.cache_hits++;
+            return cached;
+        }
+
+        uint32_t* row = _cache->insert(n);
+
+        if (row != NULL) {
+            parityMatrixRow(n, _frame_count, row);
+            return row;
+        }
+    }
+
+    parityMatrixRow(n, _frame_count, _coeffs);
+    return _coeffs;
+}
+
+void FragmentationDecoder::freeze() {
+    uint16_t col = 0;
+
+    _frozen = true;
+
+    if (_lost > _max_lost) {
+        logError("Fragmentation %u fragments lost, %u recoverable", _lost, _max_lost);
+        _state = STATE_FAILED;
+        return;
+    }
+
+    for (uint16_t w = 0; w < _frame_words; w++) {
+        uint32_t bits = _lost_map[w];
+
+        while (bits != 0) {
+            _lost_frames[col++] = w * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+        }
+    }
+}
+
+FragmentationDecoder::frag_status FragmentationDecoder::reduce() {
+    for (;;) {
+        int16_t first = firstOne(_row, _row_words);
+
+        if (first < 0) {
+            _stats.redundant++;
+            return FRAG_DECODER_OK;
+        }
+
+        uint32_t* pivot = &_matrix[first * _row_words];
+
+        if (_pivots[first / 32] & (1UL << (first % 32))) {
+            // Columns before first are zero in both rows
+            for (uint16_t w = first / 32; w < _row_words; w++)
+                _row[w] ^= pivot[w];
+
+            if (!readFrame(_lost_frames[first], _temp))
+                return FRAG_DECODER_FLASH_ERROR;
+            xorBytes(_data, _temp, _frame_size);
+            continue;
+        }
+
+        // Slot of the lost fragment of the pivot column holds the reduced data until solved
+        if (!writeFrame(_lost_frames[first], _data))
+            return FRAG_DECODER_FLASH_ERROR;
+
+        memcpy(pivot, _row, _row_words * 4);
+        _pivots[first / 32] |= 1UL << (first % 32);
+
+        if (++_filled == _lost) {
+            _state = STATE_SOLVING;
+            _solve_row = _lost;
+        }
+
+        return FRAG_DECODER_OK;
+    }
+}
+
+bool FragmentationDecoder::readFrame(uint16_t frame, uint8_t* buffer) {
+    _stats.reads++;
+
+    if (_file != NULL) {
+        return _dot->seekUserFile(*_file, (uint32_t) frame * _frame_size, SEEK_SET)
+            && _dot->readUserFile(*_file, buffer, _frame_size) == _frame_size;
+    }
+
+    if (!_fh->seekFile((uint32_t) frame * _frame_size))
+        return false;
+
+    return _fh->readFile(buffer, _frame_size) == _frame_size;
+}
+
+bool FragmentationDecoder::writeFrame(uint16_t frame, const uint8_t* buffer) {
+    _stats.writes++;
+
+    if (_file != NULL) {
+        return _dot->seekUserFile(*_file, (uint32_t) frame * _frame_size, SEEK_SET)
+            && _dot->writeUserFile(*_file, (void*) buffer, _frame_size) == _frame_size;
+    }
+
+    if (!_fh->seekFile((uint32_t) frame * _frame_size))
+        return false;
+
+    return _fh->writeFile((uint8_t*) buffer, _frame_size) == _frame_size;
+}
+
+int16_t FragmentationDecoder::firstOne(const uint32_t* row, uint16_t words) {
+    for (uint16_t w = 0; w < words; w++) {
+        if (row[w] != 0)
+            return w * 32 + __builtin_ctz(row[w]);
+    }
+
+    return -1;
+}
+
+#endif
@@ -0,0 +1,168 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAGMENTATION_DECODER_H
+#define _FRAGMENTATION_DECODER_H
+#include "mDot.h"
+#ifdef FOTA
+#include "WriteFile.h"
+#include "FotaArena.h"
+#include "FragmentationRowCache.h"
+
+#ifndef MAX_PARITY
+#define MAX_PARITY 300
+#endif
+
+class FragmentationCheckpoint;
+
+// Decoder for the fragmented data block transport. Uncoded fragments are written to
+// their place in the file. When the first coded fragment arrives the set of lost
+// fragments is fixed, each coded fragment is then reduced against the rows already
+// held and its data is kept in the file slot of a lost fragment until the matrix is
+// complete. Solving the matrix is done in steps so several decoders can share a thread.
+//
+// The decoder does not allocate, all of its buffers are carved from a workspace of
+// workspaceSize() bytes given to the constructor. create() places a decoder and its
+// workspace in a FotaArena.
+//
+// Parity matrix rows are generated packed, 32 fragments per word, and reduced a word at
+// a time. Sessions that see the same coded fragments again, e.g. a retried transfer,
+// can take generated rows from a FragmentationRowCache instead of generating them again.
+//
+// Fragments are kept through a WriteFile, or in a user file that outlives a reset when
+// the decoder state is checkpointed by FragmentationCheckpoint.
+class FragmentationDecoder {
+    public:
+        enum frag_status {
+            FRAG_DECODER_OK,
+            FRAG_DECODER_COMPLETE,
+            FRAG_DECODER_SIZE_INCORRECT,
+            FRAG_DECODER_FLASH_ERROR,
+            FRAG_DECODER_TOO_MANY_LOST,
+            FRAG_DECODER_NO_MEMORY
+        };
+
+        enum frag_state {
+            STATE_RECEIVING,
+            STATE_SOLVING,              // matrix is complete, lost fragments are being recovered
+            STATE_COMPLETE,
+            STATE_FAILED
+        };
+
+        typedef struct {
+            uint16_t frames;            // fragments processed
+            uint16_t coded;             // coded fragments processed
+            uint16_t redundant;         // coded fragments that added no information
+            uint32_t reads;             // fragments read from the file
+            uint32_t writes;            // fragments written to the file
+            uint16_t cache_hits;        // parity matrix rows taken from the row cache
+        } frag_decoder_stats;
+
+        // Bytes of workspace needed for frame_count fragments of frame_size bytes with up to max_lost lost
+        static uint32_t workspaceSize(uint16_t frame_count, uint8_t frame_size, uint16_t max_lost);
+
+        // Largest number of lost fragments that can be recovered within a workspace of size bytes
+        static uint16_t maxLost(uint16_t frame_count, uint8_t frame_size, uint32_t size);
+
+        // Bytes of arena taken by create()
+        static uint32_t arenaSize(uint16_t frame_count, uint8_t frame_size, uint16_t max_lost);
+
+        // Create a decoder and its workspace in an arena, NULL if the arena has no room
+        static FragmentationDecoder* create(FotaArena& arena, WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint16_t max_lost);
+
+        FragmentationDecoder(WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint16_t max_lost, uint8_t* workspace);
+
+        void reset();
+
+        // Keep fragments in an open user file instead of the WriteFile
+        void setFile(mDot* dot, mDot::mdot_file* file);
+
+        // Save decoder state through a checkpoint as fragments are processed and solved
+        void setCheckpoint(FragmentationCheckpoint* checkpoint);
+
+        // Take parity matrix rows from a cache, used while it holds rows of this fragment count
+        void setRowCache(FragmentationRowCache* cache);
+
+        // Process a fragment, index is the 1 based fragment number of the DataFragment command
+        frag_status processFrame(uint16_t index, const uint8_t* data, uint8_t size);
+
+        // Recover up to rows lost fragments, returns FRAG_DECODER_COMPLETE once all are recovered
+        frag_status solve(uint16_t rows);
+
+        frag_state getState();
+        uint16_t getFrameCount();
+        uint8_t getFrameSize();
+        uint16_t getMaxLost();
+
+        // Fragments not received uncoded
+        uint16_t getLost();
+
+        // Coded fragments still needed to complete the matrix, 0 once solving
+        uint16_t getNeeded();
+
+        // Lost fragments still to be recovered by solve()
+        uint16_t getSolveLeft();
+
+        frag_decoder_stats getStats();
+
+        static int prbs23(int x);
+
+        // Row n of the parity matrix for m fragments, packed with fragment i in bit i % 32 of word i / 32
+        static void parityMatrixRow(uint16_t n, uint16_t m, uint32_t* row);
+
+    private:
+        friend class FragmentationCheckpoint;
+
+        frag_status process(uint16_t index, const uint8_t* data, uint8_t size);
+        bool isLost(uint16_t frame);
+        uint16_t lostRank(uint16_t frame);
+        const uint32_t* parityRow(uint16_t n);
+        void freeze();
+        frag_status reduce();
+        bool readFrame(uint16_t frame, uint8_t* buffer);
+        bool writeFrame(uint16_t frame, const uint8_t* buffer);
+
+        static int16_t firstOne(const uint32_t* row, uint16_t words);
+
+        WriteFile* _fh;
+        mDot* _dot;
+        mDot::mdot_file* _file;         // fragment user file, used instead of _fh when set
+        FragmentationCheckpoint* _checkpoint;
+        FragmentationRowCache* _cache;
+        uint16_t _frame_count;
+        uint8_t _frame_size;
+        uint16_t _max_lost;
+        uint16_t _row_words;            // 32 bit words per matrix row
+        uint16_t _frame_words;          // 32 bit words per parity matrix row
+        uint16_t _lost;
+        uint16_t _filled;               // matrix rows held
+        uint16_t _solve_row;            // rows above this one are solved
+        bool _frozen;                   // set of lost fragments is fixed
+        frag_state _state;
+        frag_decoder_stats _stats;
+
+        uint32_t* _lost_map;            // bit per fragment, set while lost
+        uint16_t* _lost_frames;         // fragment of each matrix column
+        uint32_t* _matrix;              // upper triangular, row i has its first one in column i
+        uint32_t* _pivots;              // bit per matrix row, set when row is held
+        uint32_t* _row;
+        uint32_t* _coeffs;              // parity matrix row
+        uint8_t* _data;
+        uint8_t* _temp;
+};
+#endif
+#endif // _FRAGMENTATION_DECODER_H
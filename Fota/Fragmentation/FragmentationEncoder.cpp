@@ -0,0 +1,101 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FragmentationEncoder.h"
+
+#ifdef FOTA
+
+FragmentationEncoder::FragmentationEncoder(const uint8_t* data, uint32_t size, uint8_t frame_size, uint8_t frag_index)
+    : _data(data),
+      _size(size),
+      _frame_size(frame_size),
+      _frag_index(frag_index & 0x03)
+{
+    _frame_count = (size + frame_size - 1) / frame_size;
+    _padding = _frame_count * frame_size - size;
+    _coeffs = new uint32_t[(_frame_count + 31) / 32];
+    _temp = new uint8_t[frame_size];
+}
+
+FragmentationEncoder::~FragmentationEncoder() {
+    delete [] _coeffs;
+    delete [] _temp;
+}
+
+uint16_t FragmentationEncoder::getFrameCount() {
+    return _frame_count;
+}
+
+uint8_t FragmentationEncoder::getFrameSize() {
+    return _frame_size;
+}
+
+uint8_t FragmentationEncoder::getPadding() {
+    return _padding;
+}
+
+uint8_t FragmentationEncoder::setupRequest(uint8_t* payload) {
+    // FragSession for all multicast groups, NbFrag, FragSize, Control, Padding, Descriptor
+    payload[0] = (_frag_index << 4) | 0x0F;
+    payload[1] = _frame_count & 0xFF;
+    payload[2] = _frame_count >> 8;
+    payload[3] = _frame_size;
+    payload[4] = 0;
+    payload[5] = _padding;
+    memset(&payload[6], 0, 4);
+
+    return 10;
+}
+
+uint8_t FragmentationEncoder::fragment(uint16_t index, uint8_t* payload) {
+    uint16_t index_and_n = (_frag_index << 14) | (index & 0x3FFF);
+    uint8_t* out = &payload[2];
+
+    payload[0] = index_and_n & 0xFF;
+    payload[1] = index_and_n >> 8;
+
+    if (index <= _frame_count) {
+        frame(index - 1, out);
+        return 2 + _frame_size;
+    }
+
+    FragmentationDecoder::parityMatrixRow(index - _frame_count, _frame_count, _coeffs);
+    memset(out, 0, _frame_size);
+
+    for (uint16_t w = 0; w < (_frame_count + 31) / 32; w++) {
+        uint32_t bits = _coeffs[w];
+
+        while (bits != 0) {
+            frame(w * 32 + __builtin_ctz(bits), _temp);
+            for (uint8_t j = 0; j < _frame_size; j++)
+                out[j] ^= _temp[j];
+            bits &= bits - 1;
+        }
+    }
+
+    return 2 + _frame_size;
+}
+
+void FragmentationEncoder::frame(uint16_t frame, uint8_t* out) {
+    uint32_t offset = (uint32_t) frame * _frame_size;
+    uint32_t size = _size - offset < _frame_size ? _size - offset : _frame_size;
+
+    memcpy(out, &_data[offset], size);
+    memset(&out[size], 0, _frame_size - size);
+}
+
+#endif
@@ -0,0 +1,60 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAGMENTATION_ENCODER_H
+#define _FRAGMENTATION_ENCODER_H
+#include "mDot.h"
+#ifdef FOTA
+#include "FragmentationDecoder.h"
+
+// Splits an image into fragmented data block transport commands the way a server
+// does. Uncoded fragments are the image in frame_size pieces, the last one zero
+// padded. Coded fragments are the XOR of the fragments selected by the same parity
+// matrix row FragmentationDecoder uses. Payloads are built without the command id.
+class FragmentationEncoder {
+    public:
+        FragmentationEncoder(const uint8_t* data, uint32_t size, uint8_t frame_size, uint8_t frag_index = 0);
+        ~FragmentationEncoder();
+
+        uint16_t getFrameCount();
+        uint8_t getFrameSize();
+        uint8_t getPadding();
+
+        // Build the FragSessionSetupReq payload of the image, returns payload size
+        uint8_t setupRequest(uint8_t* payload);
+
+        // Build the DataFragment payload of a 1 based fragment index, coded when the
+        // index is above the frame count, returns payload size
+        uint8_t fragment(uint16_t index, uint8_t* payload);
+
+    private:
+        FragmentationEncoder(const FragmentationEncoder&);
+        FragmentationEncoder& operator=(const FragmentationEncoder&);
+
+        void frame(uint16_t frame, uint8_t* out);
+
+        const uint8_t* _data;
+        uint32_t _size;
+        uint8_t _frame_size;
+        uint16_t _frame_count;
+        uint8_t _padding;
+        uint8_t _frag_index;
+        uint32_t* _coeffs;              // parity matrix row
+        uint8_t* _temp;
+};
+#endif
+#endif // _FRAGMENTATION_ENCODER_H
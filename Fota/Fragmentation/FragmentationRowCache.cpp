@@ -0,0 +1,115 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FragmentationRowCache.h"
+
+#ifdef FOTA
+
+FragmentationRowCache::FragmentationRowCache()
+    : _memory(NULL),
+      _size(0),
+      _frame_count(0),
+      _frame_words(0),
+      _rows(0),
+      _used(0),
+      _data(NULL),
+      _tags(NULL),
+      _slots(NULL)
+{
+}
+
+void FragmentationRowCache::attach(uint8_t* memory, uint32_t size) {
+    _memory = memory;
+    _size = memory != NULL ? size : 0;
+    setFrameCount(0);
+}
+
+void FragmentationRowCache::setFrameCount(uint16_t frame_count) {
+    _frame_count = frame_count;
+    _frame_words = (frame_count + 31) / 32;
+    _used = 0;
+    _rows = 0;
+
+    if (_frame_words == 0)
+        return;
+
+    // Row data, then a tag and a slot index per row
+    uint32_t rows = _size / (_frame_words * 4 + 4);
+
+    _rows = rows > 0xFFFF ? 0xFFFF : rows;
+    _data = (uint32_t*) _memory;
+    _tags = (uint16_t*) (_memory + _rows * _frame_words * 4);
+    _slots = _tags + _rows;
+}
+
+const uint32_t* FragmentationRowCache::find(uint16_t n) {
+    uint16_t i = lowerBound(n);
+
+    if (i == _used || _tags[i] != n)
+        return NULL;
+
+    return &_data[_slots[i] * _frame_words];
+}
+
+uint32_t* FragmentationRowCache::insert(uint16_t n) {
+    if (_used >= _rows)
+        return NULL;
+
+    uint16_t i = lowerBound(n);
+
+    // Row data stays in its slot, only the sorted tags move
+    memmove(&_tags[i + 1], &_tags[i], (_used - i) * 2);
+    memmove(&_slots[i + 1], &_slots[i], (_used - i) * 2);
+    _tags[i] = n;
+    _slots[i] = _used;
+
+    return &_data[_used++ * _frame_words];
+}
+
+uint32_t FragmentationRowCache::getSize() {
+    return _size;
+}
+
+uint16_t FragmentationRowCache::getFrameCount() {
+    return _frame_count;
+}
+
+uint16_t FragmentationRowCache::getRows() {
+    return _rows;
+}
+
+uint16_t FragmentationRowCache::getUsed() {
+    return _used;
+}
+
+uint16_t FragmentationRowCache::lowerBound(uint16_t n) {
+    uint16_t lo = 0;
+    uint16_t hi = _used;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+
+        if (_tags[mid] < n)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+#endif
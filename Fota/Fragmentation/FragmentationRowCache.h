@@ -0,0 +1,69 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAGMENTATION_ROW_CACHE_H
+#define _FRAGMENTATION_ROW_CACHE_H
+#include "mDot.h"
+#ifdef FOTA
+
+// Parity matrix rows kept across sessions, e.g. a transfer retried after it failed. A
+// row depends only on its row number and the fragment count, so rows are keyed by
+// both and a session with the same fragment count takes them from the cache instead of
+// generating them again. The cache holds rows of one fragment count at a time and lives
+// in memory of the FragmentationWorkspace, not in a session region, so it survives
+// closing and setting up a session again.
+//
+// Rows are kept in the order they were first generated and are not replaced by later
+// rows of the same fragment count. A retry that resends more rows than fit still finds
+// the first ones instead of each row evicting the one needed next.
+class FragmentationRowCache {
+    public:
+        FragmentationRowCache();
+
+        // Use size bytes of memory owned by the caller, cached rows are dropped
+        void attach(uint8_t* memory, uint32_t size);
+
+        // Hold rows of frame_count fragments, rows of another count are dropped
+        void setFrameCount(uint16_t frame_count);
+
+        // Cached row n, NULL if it is not held
+        const uint32_t* find(uint16_t n);
+
+        // Slot to generate row n into, NULL if the cache is full
+        uint32_t* insert(uint16_t n);
+
+        uint32_t getSize();
+        uint16_t getFrameCount();
+        uint16_t getRows();             // rows that fit for the fragment count
+        uint16_t getUsed();             // rows held
+
+    private:
+        // Index of the first held row number not below n
+        uint16_t lowerBound(uint16_t n);
+
+        uint8_t* _memory;
+        uint32_t _size;
+        uint16_t _frame_count;
+        uint16_t _frame_words;
+        uint16_t _rows;
+        uint16_t _used;
+        uint32_t* _data;
+        uint16_t* _tags;                // row numbers held, ascending
+        uint16_t* _slots;               // data slot of each tag
+};
+#endif
+#endif // _FRAGMENTATION_ROW_CACHE_H
@@ -0,0 +1,267 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FragmentationWorkspace.h"
+#include "DotStats.h"
+
+#ifdef FOTA
+
+FragmentationWorkspace::FragmentationWorkspace(uint32_t size) {
+    _arena.reserve(size);
+
+    for (int8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++)
+        _regions[i].decoder = NULL;
+
+    setRowCache(FRAG_WORKSPACE_CACHE_SIZE);
+}
+
+FragmentationWorkspace::~FragmentationWorkspace() {
+    for (int8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++)
+        close(i);
+}
+
+int8_t FragmentationWorkspace::open(WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint32_t budget) {
+    for (int8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++) {
+        if (_regions[i].decoder == NULL)
+            return openAt(i, fh, frame_count, frame_size, budget) ? i : -1;
+    }
+
+    logError("No fragmentation session available");
+    return -1;
+}
+
+uint8_t FragmentationWorkspace::setup(const uint8_t* payload, uint8_t size, WriteFile* fh, uint32_t budget) {
+    // FragSession, NbFrag, FragSize, Control, Padding and an optional Descriptor
+    if (size < 6)
+        return SETUP_ENCODING_UNSUPPORTED;
+
+    uint8_t index = (payload[0] >> 4) & 0x03;
+    uint8_t status = index << 6;
+    uint16_t frame_count = payload[1] | (payload[2] << 8);
+    uint8_t frame_size = payload[3];
+    uint8_t algo = (payload[4] >> 3) & 0x07;
+
+    if (algo != 0)
+        status |= SETUP_ENCODING_UNSUPPORTED;
+    if (index >= FRAG_WORKSPACE_SESSIONS)
+        status |= SETUP_INDEX_UNSUPPORTED;
+    if (status & (SETUP_ENCODING_UNSUPPORTED | SETUP_INDEX_UNSUPPORTED))
+        return status;
+
+    // A new setup replaces the session of the same index
+    close(index);
+
+    if (!openAt(index, fh, frame_count, frame_size, budget))
+        status |= SETUP_NO_MEMORY;
+
+    return status;
+}
+
+void FragmentationWorkspace::close(int8_t id) {
+    if (id < 0 || id >= FRAG_WORKSPACE_SESSIONS)
+        return;
+
+    // Decoder and its buffers live in the region
+    _regions[id].decoder = NULL;
+    _regions[id].arena.attach(NULL, 0);
+}
+
+FragmentationDecoder* FragmentationWorkspace::getDecoder(int8_t id) {
+    if (id < 0 || id >= FRAG_WORKSPACE_SESSIONS)
+        return NULL;
+
+    return _regions[id].decoder;
+}
+
+FragmentationDecoder::frag_status FragmentationWorkspace::processFrame(int8_t id, uint16_t index, const uint8_t* data, uint8_t size) {
+    FragmentationDecoder* decoder = getDecoder(id);
+
+    if (decoder == NULL)
+        return FragmentationDecoder::FRAG_DECODER_NO_MEMORY;
+
+    return decoder->processFrame(index, data, size);
+}
+
+FragmentationDecoder::frag_status FragmentationWorkspace::processDataFragment(const uint8_t* payload, uint8_t size) {
+    DOT_STATS_TIME(SUBSYSTEM_FOTA);
+
+    if (size < 2)
+        return FragmentationDecoder::FRAG_DECODER_SIZE_INCORRECT;
+
+    uint16_t index_and_n = payload[0] | (payload[1] << 8);
+
+    return processFrame(index_and_n >> 14, index_and_n & 0x3FFF, &payload[2], size - 2);
+}
+
+int8_t FragmentationWorkspace::service(uint16_t rows) {
+    DOT_STATS_TIME(SUBSYSTEM_FOTA);
+
+    int8_t id = closest();
+
+    if (id < 0)
+        return -1;
+
+    FragmentationDecoder::frag_status status = _regions[id].decoder->solve(rows);
+
+    if (status == FragmentationDecoder::FRAG_DECODER_FLASH_ERROR)
+        logError("Fragmentation session %d flash error", id);
+
+    return status == FragmentationDecoder::FRAG_DECODER_COMPLETE ? id : -1;
+}
+
+bool FragmentationWorkspace::setRowCache(uint32_t size) {
+    for (int8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++) {
+        if (_regions[i].decoder != NULL)
+            return false;
+    }
+
+    size = FotaArena::align(size);
+    if (size > _arena.getSize())
+        return false;
+
+    _cache.attach(size > 0 ? _arena.getMemory() + _arena.getSize() - size : NULL, size);
+    return true;
+}
+
+FragmentationRowCache* FragmentationWorkspace::getRowCache() {
+    return &_cache;
+}
+
+uint32_t FragmentationWorkspace::getSize() {
+    return _arena.getSize();
+}
+
+uint32_t FragmentationWorkspace::getFree() {
+    uint32_t used = 0;
+
+    for (uint8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++)
+        used += _regions[i].arena.getSize();
+
+    return _arena.getSize() - _cache.getSize() - used;
+}
+
+uint32_t FragmentationWorkspace::getBudget(int8_t id) {
+    if (id < 0 || id >= FRAG_WORKSPACE_SESSIONS)
+        return 0;
+
+    return _regions[id].arena.getSize();
+}
+
+uint32_t FragmentationWorkspace::getPeak(int8_t id) {
+    if (id < 0 || id >= FRAG_WORKSPACE_SESSIONS)
+        return 0;
+
+    return _regions[id].arena.getPeak();
+}
+
+bool FragmentationWorkspace::openAt(int8_t id, WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint32_t budget) {
+    uint32_t offset;
+    uint16_t max_lost = frame_count < MAX_PARITY ? frame_count : MAX_PARITY;
+    uint32_t overhead = FragmentationDecoder::arenaSize(frame_count, frame_size, 0) - FragmentationDecoder::workspaceSize(frame_count, frame_size, 0);
+
+    if (budget != 0)
+        max_lost = FragmentationDecoder::maxLost(frame_count, frame_size, budget > overhead ? budget - overhead : 0);
+
+    uint32_t size = FotaArena::align(FragmentationDecoder::arenaSize(frame_count, frame_size, max_lost));
+
+    if (budget != 0 && size > budget) {
+        logError("Fragmentation budget %lu too small for %u fragments", budget, frame_count);
+        return false;
+    }
+
+    if (!findGap(size, offset)) {
+        logError("Fragmentation workspace has no room for %lu bytes", size);
+        return false;
+    }
+
+    _regions[id].arena.attach(_arena.getMemory() + offset, size);
+    _regions[id].decoder = FragmentationDecoder::create(_regions[id].arena, fh, frame_count, frame_size, max_lost);
+    if (_regions[id].decoder == NULL) {
+        _regions[id].arena.attach(NULL, 0);
+        return false;
+    }
+
+    // Cached rows are kept for a retry of the same fragment count, the cache moves to
+    // another count only when no open session uses its rows
+    if (_cache.getSize() > 0 && _cache.getFrameCount() != frame_count) {
+        bool used = false;
+
+        for (int8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++) {
+            if (i != id && _regions[i].decoder != NULL && _regions[i].decoder->getFrameCount() == _cache.getFrameCount())
+                used = true;
+        }
+
+        if (!used)
+            _cache.setFrameCount(frame_count);
+    }
+
+    if (_cache.getFrameCount() == frame_count)
+        _regions[id].decoder->setRowCache(&_cache);
+
+    logInfo("Fragmentation session %d %u x %u recovers %u lost in %lu bytes", id, frame_count, frame_size, max_lost, size);
+    return true;
+}
+
+bool FragmentationWorkspace::findGap(uint32_t size, uint32_t& offset) {
+    uint8_t* memory = _arena.getMemory();
+
+    // First fit, a gap starts at the workspace start or the end of a region
+    for (int8_t i = -1; i < FRAG_WORKSPACE_SESSIONS; i++) {
+        if (i >= 0 && _regions[i].decoder == NULL)
+            continue;
+
+        uint32_t start = i < 0 ? 0 : (_regions[i].arena.getMemory() - memory) + _regions[i].arena.getSize();
+        bool fits = start + size <= _arena.getSize() - _cache.getSize();
+
+        for (uint8_t j = 0; j < FRAG_WORKSPACE_SESSIONS && fits; j++) {
+            FotaArena& other = _regions[j].arena;
+            uint32_t other_offset = other.getMemory() - memory;
+
+            if (_regions[j].decoder != NULL && other_offset < start + size && start < other_offset + other.getSize())
+                fits = false;
+        }
+
+        if (fits) {
+            offset = start;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int8_t FragmentationWorkspace::closest() {
+    int8_t best = -1;
+    uint16_t best_left = 0;
+
+    // Sessions that are solving have no fragments left to receive and come first
+    for (int8_t i = 0; i < FRAG_WORKSPACE_SESSIONS; i++) {
+        FragmentationDecoder* decoder = _regions[i].decoder;
+
+        if (decoder == NULL || decoder->getState() != FragmentationDecoder::STATE_SOLVING)
+            continue;
+
+        if (best < 0 || decoder->getSolveLeft() < best_left) {
+            best = i;
+            best_left = decoder->getSolveLeft();
+        }
+    }
+
+    return best;
+}
+
+#endif
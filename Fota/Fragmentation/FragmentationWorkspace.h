@@ -0,0 +1,109 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAGMENTATION_WORKSPACE_H
+#define _FRAGMENTATION_WORKSPACE_H
+#include "mDot.h"
+#ifdef FOTA
+#include "FragmentationDecoder.h"
+
+#define FRAG_WORKSPACE_SESSIONS 3
+#if defined(TARGET_MTS_MDOT_F411RE)
+#define FRAG_WORKSPACE_SIZE 32768
+#else
+#define FRAG_WORKSPACE_SIZE 8192
+#endif
+#define FRAG_WORKSPACE_SOLVE_ROWS 8     // lost fragments recovered per service call
+#define FRAG_WORKSPACE_CACHE_SIZE 0     // workspace bytes kept for cached parity matrix rows
+
+// Decoding memory shared by concurrent fragmentation sessions, e.g. application
+// firmware, modem firmware and a configuration blob sent at the same time. The
+// workspace is reserved once and each session gets a region of it sized by its
+// budget, so peak heap does not grow with the number of sessions. A region is the
+// FotaArena of its session, the decoder and all of its buffers are placed in it and
+// closing the session frees them at once. service() spends its work on the session
+// closest to completion so one transfer finishes early instead of all of them late.
+//
+// The end of the workspace can be kept for a FragmentationRowCache shared by sessions
+// and kept when they close, a session set up again after a failed transfer takes the
+// parity matrix rows it generated before from the cache.
+class FragmentationWorkspace {
+    public:
+        // FragSessionSetupAns status bits
+        enum setup_status {
+            SETUP_ENCODING_UNSUPPORTED = 0x01,
+            SETUP_NO_MEMORY = 0x02,
+            SETUP_INDEX_UNSUPPORTED = 0x04,
+            SETUP_WRONG_DESCRIPTOR = 0x08
+        };
+
+        FragmentationWorkspace(uint32_t size = FRAG_WORKSPACE_SIZE);
+        ~FragmentationWorkspace();
+
+        // Open a session decoding into fh, budget limits its share of the workspace,
+        // 0 for as much as MAX_PARITY lost fragments need
+        // returns session id or -1 if there is no session or room left
+        int8_t open(WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint32_t budget = 0);
+
+        // Open the session of a FragSessionSetupReq payload, the session is refused here
+        // with SETUP_NO_MEMORY rather than failing once fragments arrive
+        // returns FragSessionSetupAns status, 0 when the session was opened
+        uint8_t setup(const uint8_t* payload, uint8_t size, WriteFile* fh, uint32_t budget = 0);
+
+        // Close a session and return its region to the workspace
+        void close(int8_t id);
+
+        FragmentationDecoder* getDecoder(int8_t id);
+
+        FragmentationDecoder::frag_status processFrame(int8_t id, uint16_t index, const uint8_t* data, uint8_t size);
+
+        // Process a DataFragment payload, the session is taken from its FragIndex
+        FragmentationDecoder::frag_status processDataFragment(const uint8_t* payload, uint8_t size);
+
+        // Recover up to rows lost fragments of the session closest to completion
+        // returns id of a session that completed or -1
+        int8_t service(uint16_t rows = FRAG_WORKSPACE_SOLVE_ROWS);
+
+        // Keep size bytes at the end of the workspace for cached parity matrix rows, 0 for no
+        // cache. Only possible while no session is open, returns false otherwise.
+        bool setRowCache(uint32_t size);
+
+        FragmentationRowCache* getRowCache();
+
+        uint32_t getSize();
+        uint32_t getFree();
+        uint32_t getBudget(int8_t id);
+
+        // Most bytes of its region a session has used, at most its budget
+        uint32_t getPeak(int8_t id);
+
+    private:
+        typedef struct {
+            FragmentationDecoder* decoder;
+            FotaArena arena;
+        } frag_region;
+
+        bool openAt(int8_t id, WriteFile* fh, uint16_t frame_count, uint8_t frame_size, uint32_t budget);
+        bool findGap(uint32_t size, uint32_t& offset);
+        int8_t closest();
+
+        FotaArena _arena;
+        frag_region _regions[FRAG_WORKSPACE_SESSIONS];
+        FragmentationRowCache _cache;
+};
+#endif
+#endif // _FRAGMENTATION_WORKSPACE_H
@@ -0,0 +1,185 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FragmentationBench.h"
+
+#if defined(FOTA) && defined(FOTA_HOST)
+#include <chrono>
+#include <vector>
+
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+FragmentationBench::FragmentationBench(const uint8_t* image, uint32_t size, uint8_t frame_size, uint32_t workspace)
+    : _image(image),
+      _size(size),
+      _frame_size(frame_size),
+      _workspace(workspace)
+{
+}
+
+FragmentationBench::bench_result FragmentationBench::run(const loss_config& loss, uint16_t max_coded) {
+    FragmentationWorkspace workspace(_workspace);
+
+    return transfer(workspace, loss, max_coded);
+}
+
+FragmentationBench::bench_result FragmentationBench::retry(const loss_config& loss, uint16_t max_coded, uint32_t row_cache) {
+    FragmentationWorkspace workspace(_workspace);
+    bench_result result;
+
+    memset(&result, 0, sizeof(result));
+
+    if (!workspace.setRowCache(row_cache))
+        return result;
+
+    transfer(workspace, loss, max_coded);
+    return transfer(workspace, loss, max_coded);
+}
+
+FragmentationBench::bench_result FragmentationBench::transfer(FragmentationWorkspace& workspace, const loss_config& loss, uint16_t max_coded) {
+    FragmentationEncoder encoder(_image, _size, _frame_size);
+    WriteFile fh(NULL);
+    bench_result result;
+    std::vector<uint8_t> payload(2 + _frame_size);
+    uint32_t state = loss.seed;
+    bool burst = false;
+    uint16_t count = encoder.getFrameCount();
+
+    memset(&result, 0, sizeof(result));
+    result.frame_count = count;
+
+    fh.createFile(count, _frame_size, encoder.getPadding());
+
+    uint8_t size = encoder.setupRequest(&payload[0]);
+    if (workspace.setup(&payload[0], size, &fh) != 0)
+        return result;
+
+    FragmentationDecoder* decoder = workspace.getDecoder(0);
+
+    for (uint32_t index = 1; index <= (uint32_t) count + max_coded; index++) {
+        if (index > count)
+            result.coded_sent++;
+
+        size = encoder.fragment(index, &payload[0]);
+
+        if (lost(loss, state, burst, index)) {
+            if (index <= count)
+                result.lost++;
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        FragmentationDecoder::frag_status status = workspace.processDataFragment(&payload[0], size);
+
+        while (decoder->getState() == FragmentationDecoder::STATE_SOLVING)
+            workspace.service();
+
+        result.decode_us += elapsedUs(start);
+
+        if (status != FragmentationDecoder::FRAG_DECODER_OK && status != FragmentationDecoder::FRAG_DECODER_COMPLETE)
+            break;
+        if (decoder->getState() != FragmentationDecoder::STATE_RECEIVING)
+            break;
+    }
+
+    FragmentationDecoder::frag_decoder_stats stats = decoder->getStats();
+
+    result.complete = decoder->getState() == FragmentationDecoder::STATE_COMPLETE;
+    result.ram = workspace.getPeak(0);
+    result.flash_read = stats.reads * _frame_size;
+    result.flash_written = stats.writes * _frame_size;
+    result.cache_hits = stats.cache_hits;
+
+    if (result.complete) {
+        fh.completeFile(count, encoder.getPadding(), count);
+        result.valid = verify(fh);
+    }
+
+    fh.cleanUp(false);
+    return result;
+}
+
+uint16_t FragmentationBench::minRedundancy(loss_config loss, uint8_t trials) {
+    uint16_t count = (_size + _frame_size - 1) / _frame_size;
+    uint16_t worst = 0;
+
+    for (uint8_t i = 0; i < trials; i++) {
+        bench_result result = run(loss, count * 4);
+
+        if (!result.complete)
+            return 0xFFFF;
+        if (result.coded_sent > worst)
+            worst = result.coded_sent;
+
+        loss.seed++;
+    }
+
+    return ((uint32_t) worst * 100 + count - 1) / count;
+}
+
+void FragmentationBench::report(const bench_result& result) {
+    logInfo("%u fragments of %u lost %u coded %u %s decode %lu us ram %lu read %lu written %lu cache hits %u",
+            result.frame_count, _frame_size, result.lost, result.coded_sent,
+            result.complete ? (result.valid ? "complete" : "corrupt") : "incomplete",
+            result.decode_us, result.ram, result.flash_read, result.flash_written, result.cache_hits);
+}
+
+bool FragmentationBench::lost(const loss_config& loss, uint32_t& state, bool& burst, uint32_t sequence) {
+    uint32_t percent;
+
+    state = state * 1103515245 + 12345;
+    percent = (state >> 16) % 100;
+
+    switch (loss.pattern) {
+        case LOSS_RANDOM:
+            return percent < loss.rate;
+
+        case LOSS_BURST: {
+            // Two state channel, leaving a burst with 1 / burst keeps mean length at burst
+            uint32_t leave = loss.burst > 0 ? 100 / loss.burst : 100;
+            uint32_t enter = loss.rate < 100 ? leave * loss.rate / (100 - loss.rate) : 100;
+
+            burst = burst ? percent >= leave : percent < enter;
+            return burst;
+        }
+
+        case LOSS_PERIODIC:
+            return loss.rate > 0 && sequence % (100 / loss.rate) == 0;
+
+        default:
+            return false;
+    }
+}
+
+bool FragmentationBench::verify(WriteFile& fh) {
+    std::vector<uint8_t> buffer(_frame_size);
+
+    for (uint32_t offset = 0; offset < _size; offset += _frame_size) {
+        uint32_t size = _size - offset < _frame_size ? _size - offset : _frame_size;
+
+        if (!fh.seekFile(offset) || fh.readFile(&buffer[0], size) != (int) size)
+            return false;
+        if (memcmp(&buffer[0], &_image[offset], size) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+#endif
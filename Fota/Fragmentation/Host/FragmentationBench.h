@@ -0,0 +1,85 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAGMENTATION_BENCH_H
+#define _FRAGMENTATION_BENCH_H
+#if defined(FOTA) && defined(FOTA_HOST)
+#include "FragmentationEncoder.h"
+#include "FragmentationWorkspace.h"
+
+// Host benchmark of a complete FOTA transfer without a network server. An image is
+// encoded into DataFragment payloads, fragments are dropped by a loss pattern and the
+// rest are fed to a FragmentationWorkspace decoding into a file backed WriteFile.
+// Only built with FOTA_HOST, see Host/WriteFileHost.cpp.
+class FragmentationBench {
+    public:
+        enum loss_pattern {
+            LOSS_NONE,
+            LOSS_RANDOM,                // each fragment lost with probability rate
+            LOSS_BURST,                 // losses in bursts of mean length burst, rate overall
+            LOSS_PERIODIC               // every 100 / rate fragment lost
+        };
+
+        typedef struct {
+            loss_pattern pattern;
+            uint8_t rate;               // percent of fragments lost
+            uint8_t burst;
+            uint32_t seed;
+        } loss_config;
+
+        typedef struct {
+            bool complete;
+            uint16_t frame_count;
+            uint16_t lost;              // uncoded fragments lost
+            uint16_t coded_sent;        // coded fragments sent until complete, lost ones included
+            uint32_t decode_us;         // time spent in the decoder
+            uint32_t ram;               // peak workspace bytes used by the session
+            uint32_t flash_read;        // bytes read from the file
+            uint32_t flash_written;     // bytes written to the file
+            uint16_t cache_hits;        // parity matrix rows taken from the row cache
+            bool valid;                 // file matches the image
+        } bench_result;
+
+        FragmentationBench(const uint8_t* image, uint32_t size, uint8_t frame_size, uint32_t workspace = FRAG_WORKSPACE_SIZE);
+
+        // Transfer the image with up to max_coded coded fragments after the uncoded ones
+        bench_result run(const loss_config& loss, uint16_t max_coded);
+
+        // Transfer the image, then set the session up again and transfer it once more with
+        // the same losses, as a retry after a failed transfer. The workspace keeps row_cache
+        // bytes of parity matrix rows across the retry, returns the result of the retry.
+        bench_result retry(const loss_config& loss, uint16_t max_coded, uint32_t row_cache);
+
+        // Coded fragments per 100 uncoded ones needed for all of trials runs to complete,
+        // seeds are loss.seed onwards, 0xFFFF if a run did not complete
+        uint16_t minRedundancy(loss_config loss, uint8_t trials);
+
+        // Log a result at info level
+        void report(const bench_result& result);
+
+    private:
+        bench_result transfer(FragmentationWorkspace& workspace, const loss_config& loss, uint16_t max_coded);
+        bool lost(const loss_config& loss, uint32_t& state, bool& burst, uint32_t sequence);
+        bool verify(WriteFile& fh);
+
+        const uint8_t* _image;
+        uint32_t _size;
+        uint8_t _frame_size;
+        uint32_t _workspace;
+};
+#endif
+#endif // _FRAGMENTATION_BENCH_H
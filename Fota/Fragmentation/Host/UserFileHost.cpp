@@ -0,0 +1,88 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+// User file calls of mDot backed by host files, for host builds of the fragmentation
+// benchmark and checkpoints and of the settings store check. Only built with FOTA_HOST
+// or STORAGE_HOST on mDot.
+
+#if (defined(FOTA) && defined(FOTA_HOST)) || (defined(STORAGE_HOST) && defined(TARGET_MTS_MDOT_F411RE))
+#include "mDot.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+mDot::mdot_file mDot::openUserFile(const char* file, int mode) {
+    mdot_file f;
+    int flags = 0;
+
+    if ((mode & FM_RDWR) == FM_RDWR)
+        flags = O_RDWR;
+    else if (mode & FM_WRONLY)
+        flags = O_WRONLY;
+    else
+        flags = O_RDONLY;
+
+    if (mode & FM_CREAT)
+        flags |= O_CREAT;
+    if (mode & FM_TRUNC)
+        flags |= O_TRUNC;
+    if (mode & FM_APPEND)
+        flags |= O_APPEND;
+
+    strncpy(f.name, file, sizeof(f.name) - 1);
+    f.name[sizeof(f.name) - 1] = '\0';
+    f.fd = open(file, flags, 0644);
+    f.size = f.fd >= 0 ? lseek(f.fd, 0, SEEK_END) : 0;
+
+    if (f.fd >= 0)
+        lseek(f.fd, 0, SEEK_SET);
+
+    return f;
+}
+
+bool mDot::seekUserFile(mDot::mdot_file& file, int32_t offset, int whence) {
+    return lseek(file.fd, offset, whence) >= 0;
+}
+
+int mDot::readUserFile(mDot::mdot_file& file, void* data, size_t length) {
+    return read(file.fd, data, length);
+}
+
+int mDot::writeUserFile(mDot::mdot_file& file, void* data, size_t length) {
+    return write(file.fd, data, length);
+}
+
+bool mDot::closeUserFile(mDot::mdot_file& file) {
+    return close(file.fd) == 0;
+}
+
+bool mDot::deleteUserFile(const char* file) {
+    return unlink(file) == 0;
+}
+
+bool mDot::appendUserFile(const char* file, void* data, uint32_t size) {
+    int fd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    bool ret;
+
+    if (fd < 0)
+        return false;
+
+    ret = write(fd, data, size) == (ssize_t) size;
+    close(fd);
+    return ret;
+}
+
+#endif
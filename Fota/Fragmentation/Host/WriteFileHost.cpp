@@ -0,0 +1,102 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+// File backed WriteFile for host builds of the fragmentation benchmark, the library
+// version writes to the user file system of the dot. Only built with FOTA_HOST.
+
+#if defined(FOTA) && defined(FOTA_HOST)
+#include "WriteFile.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static uint16_t host_files = 0;
+
+WriteFile::WriteFile(mDot* dot)
+    : _dot(dot),
+      _temp(NULL),
+      _frag(NULL),
+      _padding(0),
+      _frag_size(0),
+      _num_frags(0)
+{
+    _file.fd = -1;
+    _upgrade.fd = -1;
+    snprintf(_file.name, sizeof(_file.name), "fota_%u.tmp", host_files++);
+}
+
+WriteFile::~WriteFile() {
+    // Completed files are kept for inspection
+    cleanUp(_file.size != 0);
+}
+
+int WriteFile::writeFile(uint8_t* buffer, uint32_t size) {
+    return write(_file.fd, buffer, size);
+}
+
+int WriteFile::readFile(uint8_t* buffer, uint32_t size) {
+    // Slots not written yet read as erased flash
+    int count = read(_file.fd, buffer, size);
+
+    if (count >= 0 && (uint32_t) count < size) {
+        memset(&buffer[count], 0xFF, size - count);
+        count = size;
+    }
+
+    return count;
+}
+
+int WriteFile::seekFile(uint32_t index) {
+    return lseek(_file.fd, index, SEEK_SET) >= 0;
+}
+
+int WriteFile::createFile(uint16_t numOfFrags, uint8_t fragSize, uint8_t padding) {
+    reset();
+
+    _num_frags = numOfFrags;
+    _frag_size = fragSize;
+    _padding = padding;
+    _file.fd = open(_file.name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    _file.size = 0;
+
+    return _file.fd >= 0;
+}
+
+uint64_t WriteFile::completeFile(uint16_t numOfFrags, uint8_t padding, uint32_t) {
+    uint32_t size = (uint32_t) numOfFrags * _frag_size - padding;
+
+    if (ftruncate(_file.fd, size) != 0)
+        return 0;
+
+    _file.size = size;
+    return size;
+}
+
+void WriteFile::cleanUp(bool complete) {
+    if (_file.fd >= 0)
+        close(_file.fd);
+    _file.fd = -1;
+
+    if (!complete)
+        unlink(_file.name);
+}
+
+void WriteFile::reset() {
+    cleanUp(false);
+}
+
+#endif
@@ -0,0 +1,243 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "MulticastTable.h"
+
+MulticastTable::MulticastTable(uint8_t capacity)
+    : _count(0)
+{
+    if (capacity == 0)
+        capacity = 1;
+    if (capacity > MULTICAST_TABLE_MAX_CAPACITY)
+        capacity = MULTICAST_TABLE_MAX_CAPACITY;
+
+    // Keep the hash at most half full so probe sequences stay short
+    uint16_t slots = 1;
+    while (slots < 2 * capacity)
+        slots <<= 1;
+
+    _capacity = capacity;
+    _slot_mask = slots - 1;
+    _sessions = new mc_session[capacity];
+    _slots = new uint8_t[slots];
+
+    memset(&_stats, 0, sizeof(_stats));
+    clear();
+}
+
+MulticastTable::~MulticastTable() {
+    clear();
+    delete [] _sessions;
+    delete [] _slots;
+}
+
+MulticastTable::mc_session* MulticastTable::add(uint8_t group_id, uint32_t addr, const uint8_t* nsk, const uint8_t* ask,
+                                                uint32_t fcnt_min, uint32_t fcnt_max) {
+    mc_session* session = find(addr);
+
+    if (session == NULL) {
+        uint8_t index;
+
+        if (_count >= _capacity) {
+            logWarning("Multicast table full, cannot add %08lx", addr);
+            return NULL;
+        }
+
+        for (index = 0; index < _capacity; index++) {
+            if (!_sessions[index].valid)
+                break;
+        }
+
+        uint8_t slot = slotOf(addr);
+        while (_slots[slot] != SLOT_EMPTY && _slots[slot] != SLOT_DELETED)
+            slot = (slot + 1) & _slot_mask;
+
+        _slots[slot] = index;
+        session = &_sessions[index];
+        _count++;
+    }
+
+    session->valid = true;
+    session->group_id = group_id;
+    session->addr = addr;
+    session->fcnt_down = 0;
+    session->fcnt_min = fcnt_min;
+    session->fcnt_max = fcnt_max;
+    session->fcnt_seen = false;
+    session->periodicity = -1;
+    session->dr = 0;
+    session->freq = 0;
+    session->nwk.SetKey(nsk);
+    session->app.SetKey(ask);
+
+    return session;
+}
+
+bool MulticastTable::remove(uint32_t addr) {
+    int16_t slot = findSlot(addr);
+
+    if (slot < 0)
+        return false;
+
+    mc_session& session = _sessions[_slots[slot]];
+    session.valid = false;
+    session.nwk.Clear();
+    session.app.Clear();
+
+    // Leave a marker so probe sequences through this slot still reach later sessions
+    _slots[slot] = SLOT_DELETED;
+    _count--;
+    return true;
+}
+
+void MulticastTable::clear() {
+    for (uint8_t i = 0; i < _capacity; i++) {
+        _sessions[i].valid = false;
+        _sessions[i].nwk.Clear();
+        _sessions[i].app.Clear();
+    }
+
+    memset(_slots, SLOT_EMPTY, _slot_mask + 1);
+    _count = 0;
+}
+
+MulticastTable::mc_session* MulticastTable::find(uint32_t addr) {
+    int16_t slot = findSlot(addr);
+
+    return slot < 0 ? NULL : &_sessions[_slots[slot]];
+}
+
+MulticastTable::mc_session* MulticastTable::findGroup(uint8_t group_id) {
+    for (uint8_t i = 0; i < _capacity; i++) {
+        if (_sessions[i].valid && _sessions[i].group_id == group_id)
+            return &_sessions[i];
+    }
+
+    return NULL;
+}
+
+bool MulticastTable::checkCounter(mc_session* session, uint16_t fcnt16, uint32_t& fcnt) {
+    if (session->fcnt_seen) {
+        // Next counter with these low bits after the last accepted one
+        fcnt = (session->fcnt_down & 0xFFFF0000) | fcnt16;
+        if (fcnt <= session->fcnt_down)
+            fcnt += 0x10000;
+
+        if (fcnt - session->fcnt_down > MULTICAST_FCNT_MAX_GAP) {
+            _stats.replays++;
+            return false;
+        }
+    } else {
+        fcnt = (session->fcnt_min & 0xFFFF0000) | fcnt16;
+        if (fcnt < session->fcnt_min)
+            fcnt += 0x10000;
+    }
+
+    if (fcnt < session->fcnt_min || fcnt > session->fcnt_max) {
+        _stats.replays++;
+        return false;
+    }
+
+    return true;
+}
+
+void MulticastTable::acceptCounter(mc_session* session, uint32_t fcnt) {
+    session->fcnt_down = fcnt;
+    session->fcnt_seen = true;
+}
+
+bool MulticastTable::receive(uint32_t addr, uint16_t fcnt16, const uint8_t* frame, uint8_t frame_size, uint32_t mic,
+                             uint8_t* payload, uint8_t payload_size) {
+    mc_session* session = find(addr);
+    uint32_t fcnt;
+
+    if (session == NULL || !checkCounter(session, fcnt16, fcnt))
+        return false;
+
+    if (session->nwk.ComputeMic(lora::CRYPTO_DOWNLINK, addr, fcnt, frame, frame_size) != mic) {
+        logDebug("Multicast %08lx MIC mismatch", addr);
+        return false;
+    }
+
+    acceptCounter(session, fcnt);
+    session->app.Crypt(lora::CRYPTO_DOWNLINK, addr, fcnt, payload, payload_size);
+    return true;
+}
+
+uint8_t MulticastTable::load(mDot* dot) {
+    lora::Settings* settings = dot->getSettings();
+    uint8_t added = 0;
+
+    for (uint8_t i = 0; i < lora::MAX_MULTICAST_SESSIONS; i++) {
+        lora::MulticastSession& mc = settings->Multicast[i];
+
+        if (mc.Address == 0)
+            continue;
+
+        mc_session* session = add(i, mc.Address, mc.NetworkSessionKey, mc.DataSessionKey);
+        if (session == NULL)
+            break;
+
+        session->fcnt_down = mc.DownlinkCounter;
+        session->fcnt_seen = mc.DownlinkCounter != 0;
+        session->periodicity = mc.Periodicity;
+        session->dr = mc.DatarateIndex;
+        session->freq = mc.Frequency;
+        added++;
+    }
+
+    return added;
+}
+
+uint8_t MulticastTable::getCapacity() {
+    return _capacity;
+}
+
+uint8_t MulticastTable::getCount() {
+    return _count;
+}
+
+MulticastTable::mc_table_stats MulticastTable::getStats() {
+    return _stats;
+}
+
+uint8_t MulticastTable::slotOf(uint32_t addr) {
+    // Fibonacci hashing, top bits of the product are the best mixed
+    return ((uint32_t) (addr * 2654435761UL) >> 24) & _slot_mask;
+}
+
+int16_t MulticastTable::findSlot(uint32_t addr) {
+    uint8_t slot = slotOf(addr);
+
+    _stats.lookups++;
+
+    for (uint16_t i = 0; i <= _slot_mask; i++) {
+        uint8_t index = _slots[slot];
+
+        _stats.probes++;
+
+        if (index == SLOT_EMPTY)
+            return -1;
+
+        if (index != SLOT_DELETED && _sessions[index].addr == addr)
+            return slot;
+
+        slot = (slot + 1) & _slot_mask;
+    }
+
+    return -1;
+}
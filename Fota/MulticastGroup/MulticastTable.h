@@ -0,0 +1,111 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _MULTICAST_TABLE_H
+#define _MULTICAST_TABLE_H
+#include "mDot.h"
+#include "CryptoContext.h"
+
+#if defined(TARGET_MTS_MDOT_F411RE)
+#define MULTICAST_TABLE_CAPACITY 8
+#else
+#define MULTICAST_TABLE_CAPACITY 4
+#endif
+#define MULTICAST_TABLE_MAX_CAPACITY 64
+#define MULTICAST_FCNT_MAX_GAP 16384        // largest counter jump accepted within a window
+
+// Multicast sessions beyond the MULTICAST_SESSIONS groups of MulticastGroup. Sessions are
+// found by address through a small open addressed hash, each keeps its own frame counter
+// window and expanded key contexts so a frame is checked without a linear scan or a key
+// schedule expansion. All memory is allocated once by the constructor.
+class MulticastTable {
+    public:
+        typedef struct {
+            bool valid;
+            uint8_t group_id;
+            uint32_t addr;
+            uint32_t fcnt_down;             // last accepted downlink counter
+            uint32_t fcnt_min;              // lowest counter of the session window
+            uint32_t fcnt_max;              // highest counter of the session window
+            bool fcnt_seen;                 // a frame has been accepted
+            int8_t periodicity;             // class B ping periodicity, -1 for class C
+            uint8_t dr;
+            uint32_t freq;
+            lora::CryptoContext nwk;        // network session key context for the MIC
+            lora::CryptoContext app;        // application session key context for the payload
+        } mc_session;
+
+        typedef struct {
+            uint32_t lookups;
+            uint32_t probes;                // hash slots inspected by lookups
+            uint32_t replays;               // frames rejected by the counter window
+        } mc_table_stats;
+
+        MulticastTable(uint8_t capacity = MULTICAST_TABLE_CAPACITY);
+        ~MulticastTable();
+
+        // Add or replace the session of an address
+        // returns session or NULL if the table is full
+        mc_session* add(uint8_t group_id, uint32_t addr, const uint8_t* nsk, const uint8_t* ask,
+                        uint32_t fcnt_min = 0, uint32_t fcnt_max = 0xFFFFFFFF);
+
+        // Remove the session of an address, keys are cleared
+        bool remove(uint32_t addr);
+
+        // Remove all sessions
+        void clear();
+
+        // Find the session of an address, NULL if none
+        mc_session* find(uint32_t addr);
+
+        // Find the session of a group id, NULL if none
+        mc_session* findGroup(uint8_t group_id);
+
+        // Expand a 16 bit frame counter and check it against the session window
+        // returns true if the counter may be accepted, full counter in fcnt
+        bool checkCounter(mc_session* session, uint16_t fcnt16, uint32_t& fcnt);
+
+        // Record an accepted frame counter after the MIC has been verified
+        void acceptCounter(mc_session* session, uint32_t fcnt);
+
+        // Check the MIC of a frame and decrypt its payload in place
+        // returns true if the frame was accepted
+        bool receive(uint32_t addr, uint16_t fcnt16, const uint8_t* frame, uint8_t frame_size, uint32_t mic,
+                     uint8_t* payload, uint8_t payload_size);
+
+        // Add the sessions stored in the settings of the dot
+        uint8_t load(mDot* dot);
+
+        uint8_t getCapacity();
+        uint8_t getCount();
+        mc_table_stats getStats();
+
+    private:
+        static const uint8_t SLOT_EMPTY = 0xFF;
+        static const uint8_t SLOT_DELETED = 0xFE;
+
+        uint8_t slotOf(uint32_t addr);
+        int16_t findSlot(uint32_t addr);
+
+        mc_session* _sessions;
+        uint8_t* _slots;                    // session index of each hash slot
+        uint8_t _capacity;
+        uint8_t _slot_mask;
+        uint8_t _count;
+        mc_table_stats _stats;
+};
+#endif // _MULTICAST_TABLE_H
@@ -0,0 +1,258 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "FrameCounterJournal.h"
+#include "Crc16.h"
+
+FrameCounterJournal::FrameCounterJournal(mDot* dot, uint16_t interval)
+    : _dot(dot),
+      _interval(interval),
+      _seq(0),
+      _count(0),
+      _file(0),
+      _valid(false)
+{
+    memset(&_last, 0, sizeof(_last));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+FrameCounterJournal::~FrameCounterJournal() {
+}
+
+bool FrameCounterJournal::restore() {
+    fcnt_record record;
+
+    if (!readLast(record)) {
+        logInfo("No frame counter journal found");
+        return false;
+    }
+
+    _seq = record.seq;
+    _last = record;
+    _valid = true;
+
+    if (record.address != _dot->getSettings()->Session.Address) {
+        logWarning("Frame counter journal is for address %08lx", record.address);
+        return false;
+    }
+
+    // Every downlink is committed, skipping ahead would reject the next downlinks of the server
+    if (record.up > _dot->getUpLinkCounter())
+        _dot->setUpLinkCounter(record.up);
+    if (record.down > _dot->getDownLinkCounter())
+        _dot->setDownLinkCounter(record.down);
+
+    logInfo("Restored frame counters up: %lu down: %lu", record.up, record.down);
+
+    // Reserve the next block before the first uplink, counters up to record.up may have been used
+    return commit();
+}
+
+bool FrameCounterJournal::update() {
+    lora::Settings* settings = _dot->getSettings();
+
+    if (!_valid
+        || _last.address != settings->Session.Address
+        || _dot->getUpLinkCounter() + 1 >= _last.up
+        || _dot->getDownLinkCounter() > _last.down) {
+        return commit();
+    }
+
+    return false;
+}
+
+bool FrameCounterJournal::commit() {
+    fcnt_record record;
+
+    // Pick up sequence and position of an existing journal
+    if (!_valid && readLast(record)) {
+        _seq = record.seq;
+    }
+
+    record.address = _dot->getSettings()->Session.Address;
+    record.up = _dot->getUpLinkCounter() + _interval;
+    record.down = _dot->getDownLinkCounter();
+    record.seq = _seq + 1;
+    record.crc = crc(record);
+
+    if (!write(record)) {
+        logError("Failed to write frame counter journal");
+        _stats.errors++;
+        return false;
+    }
+
+    _seq = record.seq;
+    _last = record;
+    _valid = true;
+    _stats.commits++;
+    _stats.bytes_written += sizeof(record);
+
+    logDebug("Frame counter journal up: %lu down: %lu seq: %u", record.up, record.down, record.seq);
+    return true;
+}
+
+void FrameCounterJournal::setInterval(uint16_t interval) {
+    _interval = interval > 0 ? interval : 1;
+}
+
+uint16_t FrameCounterJournal::getInterval() {
+    return _interval;
+}
+
+FrameCounterJournal::fcnt_journal_stats FrameCounterJournal::getStats() {
+    return _stats;
+}
+
+uint16_t FrameCounterJournal::crc(const fcnt_record& record) {
+    // CRC-16 CCITT over the record, excluding the crc field
+    return lora::Crc16::Compute((const uint8_t*) &record, offsetof(fcnt_record, crc), lora::CRC16_RECORD_INIT);
+}
+
+#if defined(TARGET_MTS_MDOT_F411RE)
+
+const char* FrameCounterJournal::fileName(uint8_t file) {
+    return file == 0 ? FCNT_JOURNAL_FILE_A : FCNT_JOURNAL_FILE_B;
+}
+
+bool FrameCounterJournal::readLast(fcnt_record& last) {
+    fcnt_record record;
+    bool found = false;
+
+    _count = 0;
+    _file = 0;
+
+    // Both files exist after a reset during compaction, the latest record picks the journal
+    for (uint8_t i = 0; i < 2; i++) {
+        mDot::mdot_file file = _dot->openUserFile(fileName(i), mDot::FM_RDONLY);
+        uint16_t count = 0;
+
+        if (file.fd < 0)
+            continue;
+
+        while (_dot->readUserFile(file, &record, sizeof(record)) == sizeof(record)) {
+            count++;
+
+            if (record.crc == crc(record) && (!found || (int16_t)(record.seq - last.seq) > 0)) {
+                last = record;
+                found = true;
+                _file = i;
+            }
+        }
+
+        _dot->closeUserFile(file);
+
+        if (found && _file == i)
+            _count = count;
+    }
+
+    return found;
+}
+
+bool FrameCounterJournal::write(fcnt_record& record) {
+    if (_count >= FCNT_JOURNAL_RECORDS) {
+        // Compact into the other file, the current journal stays valid until the new one is written
+        uint8_t next = _file ^ 1;
+
+        if (!_dot->saveUserFile(fileName(next), &record, sizeof(record)))
+            return false;
+
+        _dot->deleteUserFile(fileName(_file));
+        _file = next;
+        _count = 1;
+        _stats.compactions++;
+        return true;
+    }
+
+    if (!_dot->appendUserFile(fileName(_file), &record, sizeof(record)))
+        return false;
+
+    _count++;
+    return true;
+}
+
+bool FrameCounterJournal::clear() {
+    bool ret = true;
+
+    _valid = false;
+    _count = 0;
+    _file = 0;
+    memset(&_last, 0, sizeof(_last));
+
+    // Only files that exist are deleted
+    for (uint8_t i = 0; i < 2; i++) {
+        mDot::mdot_file file = _dot->openUserFile(fileName(i), mDot::FM_RDONLY);
+
+        if (file.fd < 0)
+            continue;
+
+        _dot->closeUserFile(file);
+        ret &= _dot->deleteUserFile(fileName(i));
+    }
+
+    return ret;
+}
+
+#else
+
+bool FrameCounterJournal::readLast(fcnt_record& last) {
+    fcnt_record record;
+    bool found = false;
+
+    // _count is the next slot to write
+    _count = 0;
+
+    for (uint16_t slot = 0; slot < FCNT_JOURNAL_NVM_SLOTS; slot++) {
+        if (!_dot->nvmRead(FCNT_JOURNAL_NVM_ADDR + slot * sizeof(record), &record, sizeof(record)))
+            return false;
+
+        if (record.crc == crc(record) && (!found || (int16_t)(record.seq - last.seq) > 0)) {
+            last = record;
+            found = true;
+            _count = (slot + 1) % FCNT_JOURNAL_NVM_SLOTS;
+        }
+    }
+
+    return found;
+}
+
+bool FrameCounterJournal::write(fcnt_record& record) {
+    // Writes rotate through the slots to spread EEPROM wear
+    if (!_dot->nvmWrite(FCNT_JOURNAL_NVM_ADDR + _count * sizeof(record), &record, sizeof(record)))
+        return false;
+
+    _count = (_count + 1) % FCNT_JOURNAL_NVM_SLOTS;
+    return true;
+}
+
+bool FrameCounterJournal::clear() {
+    fcnt_record record;
+    bool ret = true;
+
+    memset(&record, 0, sizeof(record));
+
+    for (uint16_t slot = 0; slot < FCNT_JOURNAL_NVM_SLOTS; slot++) {
+        ret &= _dot->nvmWrite(FCNT_JOURNAL_NVM_ADDR + slot * sizeof(record), &record, sizeof(record));
+    }
+
+    _valid = false;
+    _count = 0;
+    memset(&_last, 0, sizeof(_last));
+
+    return ret;
+}
+
+#endif /* TARGET_MTS_MDOT_F411RE */
@@ -0,0 +1,94 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _FRAME_COUNTER_JOURNAL_H
+#define _FRAME_COUNTER_JOURNAL_H
+#include "mDot.h"
+
+#define FCNT_JOURNAL_INTERVAL 16            // uplinks between commits, uplink counter skips ahead this much on restore
+#define FCNT_JOURNAL_RECORDS 64             // records kept before the journal is compacted
+#if defined(TARGET_MTS_MDOT_F411RE)
+#define FCNT_JOURNAL_FILE_A "fcnt_journal_a"
+#define FCNT_JOURNAL_FILE_B "fcnt_journal_b"  // journals alternate on compaction
+#else
+#define FCNT_JOURNAL_NVM_ADDR 0x1700        // start of EEPROM ring, user range is 0 - 0x17FF
+#define FCNT_JOURNAL_NVM_SLOTS 16
+#endif
+
+// Keeps uplink and downlink counters of the network session without saving the whole
+// configuration. Counters are appended as small records every FCNT_JOURNAL_INTERVAL uplinks,
+// the stored uplink counter is the next value that may be used so a restore never reuses one.
+// A record is also appended for every downlink received, downlinks are rare and the downlink
+// counter is restored exactly so the next downlinks of the server are accepted. mDot appends to one of two user files, compaction starts
+// the other file so a reset while compacting leaves the previous journal intact. xDot writes
+// a ring of slots in EEPROM.
+class FrameCounterJournal {
+    public:
+        typedef struct {
+            uint32_t address;
+            uint32_t up;                    // uplink counter reserved up to
+            uint32_t down;
+            uint16_t seq;
+            uint16_t crc;
+        } fcnt_record;
+
+        typedef struct {
+            uint32_t commits;
+            uint32_t bytes_written;
+            uint32_t compactions;
+            uint32_t errors;
+        } fcnt_journal_stats;
+
+        FrameCounterJournal(mDot* dot, uint16_t interval = FCNT_JOURNAL_INTERVAL);
+        ~FrameCounterJournal();
+
+        // Restore counters of the current session from the journal
+        // returns true if a record for the session address was found
+        bool restore();
+
+        // Check counters after a frame is sent or received, commits a record when needed
+        // returns true if a record was written
+        bool update();
+
+        // Write a record now
+        bool commit();
+
+        // Remove all records, call when a new session is joined
+        bool clear();
+
+        void setInterval(uint16_t interval);
+        uint16_t getInterval();
+        fcnt_journal_stats getStats();
+
+    private:
+        bool readLast(fcnt_record& record);
+        bool write(fcnt_record& record);
+        static uint16_t crc(const fcnt_record& record);
+#if defined(TARGET_MTS_MDOT_F411RE)
+        static const char* fileName(uint8_t file);
+#endif
+
+        mDot* _dot;
+        uint16_t _interval;
+        uint16_t _seq;
+        uint16_t _count;                    // records since last compaction
+        uint8_t _file;                      // journal file appended to
+        bool _valid;                        // _last holds the latest record
+        fcnt_record _last;
+        fcnt_journal_stats _stats;
+};
+#endif // _FRAME_COUNTER_JOURNAL_H
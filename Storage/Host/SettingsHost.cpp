@@ -0,0 +1,50 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+// Settings and EEPROM of mDot on the host, for host builds of the settings store check.
+// Only built with STORAGE_HOST.
+
+#if defined(STORAGE_HOST)
+#include "mDot.h"
+
+static lora::Settings settings;
+
+lora::Settings* mDot::getSettings() {
+    return &settings;
+}
+
+#if !defined(TARGET_MTS_MDOT_F411RE)
+static uint8_t eeprom[0x1800];
+
+bool mDot::nvmWrite(uint16_t addr, void* data, uint16_t size) {
+    if (addr + size > sizeof(eeprom))
+        return false;
+
+    memcpy(&eeprom[addr], data, size);
+    return true;
+}
+
+bool mDot::nvmRead(uint16_t addr, void* data, uint16_t size) {
+    if (addr + size > sizeof(eeprom))
+        return false;
+
+    memcpy(data, &eeprom[addr], size);
+    return true;
+}
+#endif
+
+#endif
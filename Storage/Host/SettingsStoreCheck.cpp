@@ -0,0 +1,115 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "SettingsStoreCheck.h"
+
+#if defined(STORAGE_HOST)
+
+SettingsStoreCheck::SettingsStoreCheck(mDot* dot)
+    : _dot(dot)
+{
+}
+
+SettingsStoreCheck::check_result SettingsStoreCheck::run() {
+    lora::Settings* settings = _dot->getSettings();
+    lora::Settings saved;
+    check_result result;
+
+    memset(&result, 0, sizeof(result));
+    remove();
+
+    settings->Session.Joined = true;
+    settings->Session.Address = 0x26011234;
+    memset(settings->Session.NetworkSessionKey, 0x2B, sizeof(settings->Session.NetworkSessionKey));
+
+    SettingsStore store(_dot);
+    result.first = save(store);
+    result.unchanged = save(store);
+
+    // State the MAC changes with every uplink
+    settings->Session.UplinkCounter++;
+    settings->Session.DownlinkCounter++;
+    settings->Session.TxDatarate ^= 1;
+    settings->Session.ChannelMask[0] ^= 0x0001;
+    result.uplink = save(store);
+
+    settings->Session.NetworkSessionKey[0] ^= 0xFF;
+    result.rekey = save(store);
+
+    // Reload into cleared settings
+    saved = *settings;
+    *settings = lora::Settings();
+
+    SettingsStore reload(_dot);
+    result.reloaded = reload.load()
+        && memcmp(&settings->Device, &saved.Device, sizeof(saved.Device)) == 0
+        && memcmp(&settings->Network, &saved.Network, sizeof(saved.Network)) == 0
+        && memcmp(&settings->Session, &saved.Session, sizeof(saved.Session)) == 0
+        && memcmp(settings->Multicast, saved.Multicast, sizeof(saved.Multicast)) == 0
+        && memcmp(&settings->Test, &saved.Test, sizeof(saved.Test)) == 0;
+
+    reload.setJournaledCounters(true);
+    settings->Session.UplinkCounter++;
+    settings->Session.DownlinkCounter++;
+    result.journaled = save(reload);
+
+    // A session without its hot block must not be resumed
+    reload.erase(SettingsStore::SECTION_SESSION_HOT);
+
+    SettingsStore missing(_dot);
+    result.hot_missing = !missing.load() && !settings->Session.Joined;
+
+    result.passed = result.first.sections == SettingsStore::NUM_SECTIONS
+        && result.unchanged.bytes == 0
+        && result.uplink.sections == 1
+        && result.journaled.bytes == 0
+        && result.rekey.sections == 1
+        && result.reloaded
+        && result.hot_missing;
+
+    remove();
+    return result;
+}
+
+void SettingsStoreCheck::report(const check_result& result) {
+    logInfo("first %lu bytes %lu sections unchanged %lu bytes uplink %lu bytes %lu sections journaled %lu bytes",
+            result.first.bytes, result.first.sections, result.unchanged.bytes, result.uplink.bytes,
+            result.uplink.sections, result.journaled.bytes);
+    logInfo("rekey %lu bytes %lu sections reload %s hot missing %s: %s",
+            result.rekey.bytes, result.rekey.sections, result.reloaded ? "ok" : "failed",
+            result.hot_missing ? "rejected" : "accepted", result.passed ? "passed" : "FAILED");
+}
+
+SettingsStoreCheck::step_result SettingsStoreCheck::save(SettingsStore& store) {
+    uint32_t sections = store.getStats().sections_written;
+    int32_t written = store.save();
+    step_result result;
+
+    result.bytes = written > 0 ? written : 0;
+    result.sections = store.getStats().sections_written - sections;
+    return result;
+}
+
+void SettingsStoreCheck::remove() {
+    SettingsStore store(_dot);
+
+    for (uint8_t sec = 0; sec < SettingsStore::NUM_SECTIONS; sec++) {
+        store.erase((SettingsStore::section) sec);
+    }
+}
+
+#endif
@@ -0,0 +1,60 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _SETTINGS_STORE_CHECK_H
+#define _SETTINGS_STORE_CHECK_H
+#if defined(STORAGE_HOST)
+#include "SettingsStore.h"
+
+// Host check of the bytes SettingsStore writes for typical changes. Each step changes the
+// settings the way the stack does and records the bytes and sections written by save().
+// Only built with STORAGE_HOST, settings come from Host/SettingsHost.cpp and mDot user
+// files from Fota/Fragmentation/Host/UserFileHost.cpp.
+class SettingsStoreCheck {
+    public:
+        typedef struct {
+            uint32_t bytes;                 // bytes written by the step
+            uint32_t sections;              // sections written by the step
+        } step_result;
+
+        typedef struct {
+            step_result first;              // first save, every section
+            step_result unchanged;          // save without changes, nothing
+            step_result uplink;             // counters, datarate and masks, hot block only
+            step_result journaled;          // counters kept by FrameCounterJournal, nothing
+            step_result rekey;              // new session keys, cold session only
+            bool reloaded;                  // load() restores the saved settings
+            bool hot_missing;               // load() fails and clears Joined without the hot block
+            bool passed;
+        } check_result;
+
+        SettingsStoreCheck(mDot* dot);
+
+        // Run all steps on the settings of dot, stored sections are removed first
+        check_result run();
+
+        // Log a result at info level
+        void report(const check_result& result);
+
+    private:
+        step_result save(SettingsStore& store);
+        void remove();
+
+        mDot* _dot;
+};
+#endif
+#endif // _SETTINGS_STORE_CHECK_H
@@ -0,0 +1,421 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "SettingsStore.h"
+#include "Crc16.h"
+
+static const uint8_t SETTINGS_STORE_MAGIC = 0x53;
+static const uint8_t NO_COPY = 0xFF;
+
+// Layout version of each section, increase when the stored layout of a section changes
+static const uint8_t SECTION_VERSIONS[] = { 1, 1, 1, 1, 1, 1 };
+
+SettingsStore::SettingsStore(mDot* dot)
+    : _dot(dot),
+      _journaled_counters(false)
+{
+    memset(&_stats, 0, sizeof(_stats));
+
+    for (uint8_t i = 0; i < NUM_SECTIONS; i++) {
+        _policy[i] = POLICY_ON_SAVE;
+        _seq[i] = 0;
+        _copy[i] = NO_COPY;
+        _crc[i] = ~sectionCrc(i);
+    }
+
+#if !defined(TARGET_MTS_MDOT_F411RE)
+    // Both copies of every section must end below the frame counter journal
+    MBED_STATIC_ASSERT(SETTINGS_STORE_NVM_ADDR + 2 * (NUM_SECTIONS * sizeof(section_header)
+                           + sizeof(lora::DeviceConfig) + sizeof(lora::NetworkConfig) + sizeof(lora::NetworkSession)
+                           + sizeof(session_hot) + lora::MAX_MULTICAST_SESSIONS * sizeof(lora::MulticastSession) + sizeof(lora::Testing)) <= SETTINGS_STORE_NVM_END,
+                       "Settings store does not fit in EEPROM area");
+#endif
+}
+
+SettingsStore::~SettingsStore() {
+}
+
+bool SettingsStore::load() {
+    bool all = true;
+
+    for (uint8_t sec = 0; sec < NUM_SECTIONS; sec++) {
+        section_header header;
+        uint8_t* data;
+        uint16_t size;
+
+        if (_policy[sec] == POLICY_VOLATILE)
+            continue;
+
+        getSection(sec, data, size);
+        _copy[sec] = NO_COPY;
+
+        uint8_t* buf = new uint8_t[size];
+
+        for (uint8_t copy = 0; copy < 2; copy++) {
+            if (!readCopy(sec, copy, header, buf, size))
+                continue;
+
+            if (header.magic != SETTINGS_STORE_MAGIC || header.version != SECTION_VERSIONS[sec] || header.section != sec
+                || header.length != size || header.crc != crc(buf, size))
+                continue;
+
+            // Keep the copy with the newest sequence
+            if (_copy[sec] == NO_COPY || (int8_t)(header.seq - _seq[sec]) > 0) {
+                memcpy(data, buf, size);
+                _seq[sec] = header.seq;
+                _copy[sec] = copy;
+            }
+        }
+
+        delete [] buf;
+
+        // Hot block is loaded after the cold session and overrides its copy of the hot fields
+        if (sec == SECTION_SESSION_HOT && _copy[sec] != NO_COPY)
+            scatterHot();
+
+        if (_copy[sec] == NO_COPY) {
+            logWarning("Settings section %d not found", sec);
+            _crc[sec] = ~sectionCrc(sec);
+            all = false;
+        } else {
+            _crc[sec] = sectionCrc(sec);
+        }
+    }
+
+    // Without the hot block the cold session has stale counters, datarate and channel masks,
+    // resuming it could reuse uplink counters so the device has to join again
+    if (_copy[SECTION_SESSION] != NO_COPY && _copy[SECTION_SESSION_HOT] == NO_COPY
+        && _policy[SECTION_SESSION_HOT] != POLICY_VOLATILE && _dot->getSettings()->Session.Joined) {
+        logError("Settings hot session not found, session not restored");
+        _dot->getSettings()->Session.Joined = false;
+        all = false;
+    }
+
+    return all;
+}
+
+int32_t SettingsStore::save() {
+    int32_t written = 0;
+
+    for (uint8_t sec = 0; sec < NUM_SECTIONS; sec++) {
+        if (_policy[sec] != POLICY_ON_SAVE || !isDirty((section) sec))
+            continue;
+
+        int32_t ret = writeSection(sec);
+        if (ret < 0)
+            return -1;
+
+        written += ret;
+    }
+
+    _stats.saves++;
+    _stats.bytes_written += written;
+    _stats.last_bytes_written = written;
+
+    logDebug("Settings saved %ld bytes", written);
+    return written;
+}
+
+int32_t SettingsStore::saveSection(section sec) {
+    if (sec >= NUM_SECTIONS || _policy[sec] == POLICY_VOLATILE || !isDirty(sec))
+        return 0;
+
+    int32_t written = writeSection(sec);
+    if (written < 0)
+        return -1;
+
+    _stats.saves++;
+    _stats.bytes_written += written;
+    _stats.last_bytes_written = written;
+
+    return written;
+}
+
+void SettingsStore::setPolicy(section sec, policy pol) {
+    if (sec < NUM_SECTIONS)
+        _policy[sec] = pol;
+}
+
+SettingsStore::policy SettingsStore::getPolicy(section sec) {
+    return sec < NUM_SECTIONS ? (policy) _policy[sec] : POLICY_VOLATILE;
+}
+
+bool SettingsStore::isDirty(section sec) {
+    return sec < NUM_SECTIONS && _crc[sec] != sectionCrc(sec);
+}
+
+void SettingsStore::markClean() {
+    for (uint8_t sec = 0; sec < NUM_SECTIONS; sec++) {
+        _crc[sec] = sectionCrc(sec);
+    }
+}
+
+bool SettingsStore::erase(section sec) {
+    bool ret = true;
+
+    if (sec >= NUM_SECTIONS)
+        return false;
+
+    for (uint8_t copy = 0; copy < 2; copy++) {
+        ret &= eraseCopy(sec, copy);
+    }
+
+    _copy[sec] = NO_COPY;
+    _crc[sec] = ~sectionCrc(sec);
+    return ret;
+}
+
+void SettingsStore::setJournaledCounters(bool enable) {
+    bool dirty = isDirty(SECTION_SESSION_HOT);
+
+    _journaled_counters = enable;
+
+    if (!dirty)
+        _crc[SECTION_SESSION_HOT] = sectionCrc(SECTION_SESSION_HOT);
+}
+
+SettingsStore::settings_store_stats SettingsStore::getStats() {
+    return _stats;
+}
+
+void SettingsStore::getSection(uint8_t sec, uint8_t*& data, uint16_t& size) {
+    lora::Settings* settings = _dot->getSettings();
+
+    switch (sec) {
+        case SECTION_DEVICE:
+            data = (uint8_t*) &settings->Device;
+            size = sizeof(settings->Device);
+            break;
+        case SECTION_NETWORK:
+            data = (uint8_t*) &settings->Network;
+            size = sizeof(settings->Network);
+            break;
+        case SECTION_SESSION:
+            data = (uint8_t*) &settings->Session;
+            size = sizeof(settings->Session);
+            break;
+        case SECTION_SESSION_HOT:
+            gatherHot();
+            data = (uint8_t*) &_hot;
+            size = sizeof(_hot);
+            break;
+        case SECTION_MULTICAST:
+            data = (uint8_t*) settings->Multicast;
+            size = sizeof(settings->Multicast);
+            break;
+        default:
+            data = (uint8_t*) &settings->Test;
+            size = sizeof(settings->Test);
+            break;
+    }
+}
+
+uint16_t SettingsStore::sectionCrc(uint8_t sec) {
+    uint8_t* data;
+    uint16_t size;
+
+    getSection(sec, data, size);
+
+    if (sec == SECTION_SESSION) {
+        // Hot fields are tracked by the hot block, leave them out of the cold session
+        lora::NetworkSession session = _dot->getSettings()->Session;
+        session.UplinkCounter = 0;
+        session.DownlinkCounter = 0;
+        session.JoinTimeOnAir = 0;
+        session.JoinTimeOffEnd = 0;
+        session.JoinFirstAttempt = 0;
+        session.AggregatedTimeOffEnd = 0;
+        memset(session.ChannelMask, 0, sizeof(session.ChannelMask));
+        session.ChannelMask500k = 0;
+        session.TxDatarate = 0;
+        session.TxPower = 0;
+        session.AdrCounter = 0;
+        session.Redundancy = 0;
+        return crc((const uint8_t*) &session, sizeof(session));
+    }
+
+    if (sec == SECTION_SESSION_HOT && _journaled_counters) {
+        session_hot hot = _hot;
+        hot.uplink_counter = 0;
+        hot.downlink_counter = 0;
+        return crc((const uint8_t*) &hot, sizeof(hot));
+    }
+
+    return crc(data, size);
+}
+
+int32_t SettingsStore::writeSection(uint8_t sec) {
+    section_header header;
+    uint8_t* data;
+    uint16_t size;
+
+    getSection(sec, data, size);
+
+    // Write over the older copy so the newest stays valid if the write is interrupted
+    uint8_t copy = (_copy[sec] == 0) ? 1 : 0;
+
+    header.magic = SETTINGS_STORE_MAGIC;
+    header.version = SECTION_VERSIONS[sec];
+    header.section = sec;
+    header.seq = (_copy[sec] == NO_COPY) ? 0 : _seq[sec] + 1;
+    header.length = size;
+    header.crc = crc(data, size);
+
+    if (!writeCopy(sec, copy, header, data, size)) {
+        logError("Failed to save settings section %d", sec);
+        return -1;
+    }
+
+    _copy[sec] = copy;
+    _seq[sec] = header.seq;
+    _crc[sec] = sectionCrc(sec);
+    _stats.sections_written++;
+
+    return sizeof(header) + size;
+}
+
+void SettingsStore::gatherHot() {
+    lora::NetworkSession& session = _dot->getSettings()->Session;
+
+    memset(&_hot, 0, sizeof(_hot));
+    _hot.uplink_counter = session.UplinkCounter;
+    _hot.downlink_counter = session.DownlinkCounter;
+    _hot.join_time_on_air = session.JoinTimeOnAir;
+    _hot.join_time_off_end = session.JoinTimeOffEnd;
+    _hot.join_first_attempt = session.JoinFirstAttempt;
+    _hot.aggregated_time_off_end = session.AggregatedTimeOffEnd;
+    memcpy(_hot.channel_mask, session.ChannelMask, sizeof(_hot.channel_mask));
+    _hot.channel_mask_500k = session.ChannelMask500k;
+    _hot.tx_datarate = session.TxDatarate;
+    _hot.tx_power = session.TxPower;
+    _hot.adr_counter = session.AdrCounter;
+    _hot.redundancy = session.Redundancy;
+}
+
+void SettingsStore::scatterHot() {
+    lora::NetworkSession& session = _dot->getSettings()->Session;
+
+    session.UplinkCounter = _hot.uplink_counter;
+    session.DownlinkCounter = _hot.downlink_counter;
+    session.JoinTimeOnAir = _hot.join_time_on_air;
+    session.JoinTimeOffEnd = _hot.join_time_off_end;
+    session.JoinFirstAttempt = _hot.join_first_attempt;
+    session.AggregatedTimeOffEnd = _hot.aggregated_time_off_end;
+    memcpy(session.ChannelMask, _hot.channel_mask, sizeof(session.ChannelMask));
+    session.ChannelMask500k = _hot.channel_mask_500k;
+    session.TxDatarate = _hot.tx_datarate;
+    session.TxPower = _hot.tx_power;
+    session.AdrCounter = _hot.adr_counter;
+    session.Redundancy = _hot.redundancy;
+}
+
+uint16_t SettingsStore::crc(const uint8_t* data, uint16_t size) {
+    return lora::Crc16::Compute(data, size, lora::CRC16_RECORD_INIT);
+}
+
+#if defined(TARGET_MTS_MDOT_F411RE)
+
+static const char* SECTION_NAMES[] = { "device", "network", "session", "hot", "multicast", "test" };
+
+bool SettingsStore::readCopy(uint8_t sec, uint8_t copy, section_header& header, uint8_t* data, uint16_t size) {
+    char name[32];
+    bool ret;
+
+    snprintf(name, sizeof(name), SETTINGS_STORE_FILE, SECTION_NAMES[sec], 'a' + copy);
+
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_RDONLY);
+    if (file.fd < 0)
+        return false;
+
+    ret = _dot->readUserFile(file, &header, sizeof(header)) == sizeof(header)
+        && _dot->readUserFile(file, data, size) == size;
+
+    _dot->closeUserFile(file);
+    return ret;
+}
+
+bool SettingsStore::writeCopy(uint8_t sec, uint8_t copy, section_header& header, uint8_t* data, uint16_t size) {
+    char name[32];
+    bool ret;
+
+    snprintf(name, sizeof(name), SETTINGS_STORE_FILE, SECTION_NAMES[sec], 'a' + copy);
+
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_WRONLY | mDot::FM_CREAT | mDot::FM_TRUNC);
+    if (file.fd < 0)
+        return false;
+
+    ret = _dot->writeUserFile(file, &header, sizeof(header)) == sizeof(header)
+        && _dot->writeUserFile(file, data, size) == size;
+
+    _dot->closeUserFile(file);
+    return ret;
+}
+
+bool SettingsStore::eraseCopy(uint8_t sec, uint8_t copy) {
+    char name[32];
+
+    snprintf(name, sizeof(name), SETTINGS_STORE_FILE, SECTION_NAMES[sec], 'a' + copy);
+
+    mDot::mdot_file file = _dot->openUserFile(name, mDot::FM_RDONLY);
+    if (file.fd < 0)
+        return true;
+
+    _dot->closeUserFile(file);
+    return _dot->deleteUserFile(name);
+}
+
+#else
+
+uint16_t SettingsStore::copyAddress(uint8_t sec, uint8_t copy) {
+    // Sections are laid out in order, each as copy A followed by copy B
+    uint16_t addr = SETTINGS_STORE_NVM_ADDR;
+    uint8_t* data;
+    uint16_t size;
+
+    for (uint8_t i = 0; i < sec; i++) {
+        getSection(i, data, size);
+        addr += 2 * (sizeof(section_header) + size);
+    }
+
+    getSection(sec, data, size);
+    return addr + copy * (sizeof(section_header) + size);
+}
+
+bool SettingsStore::readCopy(uint8_t sec, uint8_t copy, section_header& header, uint8_t* data, uint16_t size) {
+    uint16_t addr = copyAddress(sec, copy);
+
+    return _dot->nvmRead(addr, &header, sizeof(header))
+        && _dot->nvmRead(addr + sizeof(header), data, size);
+}
+
+bool SettingsStore::writeCopy(uint8_t sec, uint8_t copy, section_header& header, uint8_t* data, uint16_t size) {
+    uint16_t addr = copyAddress(sec, copy);
+
+    // Data first, the copy only becomes valid once the header matching it is written
+    return _dot->nvmWrite(addr + sizeof(header), data, size)
+        && _dot->nvmWrite(addr, &header, sizeof(header));
+}
+
+bool SettingsStore::eraseCopy(uint8_t sec, uint8_t copy) {
+    section_header header;
+
+    // A copy without a valid header is ignored by load
+    memset(&header, 0, sizeof(header));
+    return _dot->nvmWrite(copyAddress(sec, copy), &header, sizeof(header));
+}
+
+#endif /* TARGET_MTS_MDOT_F411RE */
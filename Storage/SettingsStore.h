@@ -0,0 +1,149 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _SETTINGS_STORE_H
+#define _SETTINGS_STORE_H
+#include "mDot.h"
+
+#if defined(TARGET_MTS_MDOT_F411RE)
+#define SETTINGS_STORE_FILE "cfg_%s_%c"
+#else
+#define SETTINGS_STORE_NVM_ADDR 0x1000      // start of EEPROM area, ends below the frame counter journal
+#define SETTINGS_STORE_NVM_END 0x1700      // build fails if both copies of all sections do not fit
+#endif
+
+// Saves lora::Settings one section at a time. Each section keeps the CRC of its last
+// saved contents, only sections that changed since are written. Sections are stored
+// as A/B copies with a sequence number and layout version, a failed write leaves the
+// previous copy intact. mDot stores each copy in a user file, xDot in a fixed EEPROM area.
+//
+// The session is split in two blocks. The hot block holds the state that changes on
+// every uplink: datarate, power, counters, channel masks and duty-cycle timestamps.
+// The cold block holds the rest of the session, keys and address, and is only
+// rewritten when one of those changes. The hot block is small and kept packed so
+// saving it after an uplink does not rewrite the keys. A stored cold session without a
+// hot block is not restored, load() clears Joined so the device joins again.
+class SettingsStore {
+    public:
+        enum section {
+            SECTION_DEVICE,
+            SECTION_NETWORK,
+            SECTION_SESSION,                // cold session, keys and address
+            SECTION_SESSION_HOT,            // per-uplink session state
+            SECTION_MULTICAST,
+            SECTION_TEST,
+            NUM_SECTIONS
+        };
+
+        enum policy {
+            POLICY_ON_SAVE,                 // written by save() when changed
+            POLICY_ON_REQUEST,              // written only by saveSection()
+            POLICY_VOLATILE                 // never stored or loaded
+        };
+
+        // Session state that changes on every uplink
+        typedef struct {
+            uint32_t uplink_counter;
+            uint32_t downlink_counter;
+            uint32_t join_time_on_air;
+            uint32_t join_time_off_end;
+            uint32_t join_first_attempt;
+            uint32_t aggregated_time_off_end;
+            uint16_t channel_mask[4];
+            uint16_t channel_mask_500k;
+            uint8_t tx_datarate;
+            uint8_t tx_power;
+            uint8_t adr_counter;
+            uint8_t redundancy;
+            uint8_t reserved[2];
+        } session_hot;
+
+        typedef struct {
+            uint32_t saves;
+            uint32_t sections_written;
+            uint32_t bytes_written;
+            uint32_t last_bytes_written;    // bytes written by the last save
+        } settings_store_stats;
+
+        SettingsStore(mDot* dot);
+        ~SettingsStore();
+
+        // Load stored sections into the settings
+        // returns true if all sections were found
+        bool load();
+
+        // Write sections changed since the last load or save
+        // returns number of bytes written, negative if a write failed
+        int32_t save();
+
+        // Write one section if it changed, regardless of its policy unless volatile
+        // returns number of bytes written, negative if the write failed
+        int32_t saveSection(section sec);
+
+        // Set when a section is written, defaults to POLICY_ON_SAVE
+        void setPolicy(section sec, policy pol);
+        policy getPolicy(section sec);
+
+        // Check if a section changed since the last load or save
+        bool isDirty(section sec);
+
+        // Mark all sections as saved without writing them
+        void markClean();
+
+        // Remove both stored copies of a section, it is written by the next save
+        // returns false if a copy could not be removed
+        bool erase(section sec);
+
+        // Ignore uplink and downlink counters when checking the hot session for changes,
+        // use when counters are kept by FrameCounterJournal
+        void setJournaledCounters(bool enable);
+
+        settings_store_stats getStats();
+
+    private:
+        typedef struct {
+            uint8_t magic;
+            uint8_t version;                // layout version of the section
+            uint8_t section;
+            uint8_t seq;
+            uint16_t length;
+            uint16_t crc;
+        } section_header;
+
+        void getSection(uint8_t sec, uint8_t*& data, uint16_t& size);
+        int32_t writeSection(uint8_t sec);
+        void gatherHot();
+        void scatterHot();
+        uint16_t sectionCrc(uint8_t sec);
+        bool readCopy(uint8_t sec, uint8_t copy, section_header& header, uint8_t* data, uint16_t size);
+        bool writeCopy(uint8_t sec, uint8_t copy, section_header& header, uint8_t* data, uint16_t size);
+        bool eraseCopy(uint8_t sec, uint8_t copy);
+        static uint16_t crc(const uint8_t* data, uint16_t size);
+#if !defined(TARGET_MTS_MDOT_F411RE)
+        uint16_t copyAddress(uint8_t sec, uint8_t copy);
+#endif
+
+        mDot* _dot;
+        bool _journaled_counters;
+        session_hot _hot;                   // hot session block as stored
+        uint8_t _policy[NUM_SECTIONS];
+        uint16_t _crc[NUM_SECTIONS];        // crc of section contents when last loaded or saved
+        uint8_t _seq[NUM_SECTIONS];         // sequence of newest stored copy
+        uint8_t _copy[NUM_SECTIONS];        // newest stored copy, 0xFF if none
+        settings_store_stats _stats;
+};
+#endif // _SETTINGS_STORE_H
@@ -0,0 +1,254 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "MacAnswerPlanner.h"
+#include "ChannelPlan.h"
+#include "DotStats.h"
+
+MacAnswerPlanner::MacAnswerPlanner(mDot* dot)
+    : _dot(dot),
+      _max_defer_ms(MAC_ANSWER_MAX_DEFER_MS),
+      _pending_since(0),
+      _pending(false),
+      _piggybacked(false),
+      _separate(false),
+      _pending_bytes(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+MacAnswerPlanner::~MacAnswerPlanner() {
+}
+
+MacAnswerPlanner::uplink_plan MacAnswerPlanner::plan(uint8_t app_size) {
+    lora::Settings* settings = _dot->getSettings();
+    uplink_plan plan;
+
+    plan.mac_bytes = settings->Session.CommandBufferIndex;
+    plan.max_payload = _dot->getChannelPlan()->GetMaxPayloadSize();
+    plan.app_room = plan.max_payload > plan.mac_bytes ? plan.max_payload - plan.mac_bytes : 0;
+
+    track(plan.mac_bytes);
+    plan.pending_ms = _pending ? (uint32_t) (Kernel::get_ms_count() - _pending_since) : 0;
+
+    if (plan.mac_bytes == 0) {
+        plan.action = DECISION_NONE;
+    } else if (app_size > 0 && plan.mac_bytes <= MAC_ANSWER_MAX_FOPTS && app_size <= plan.app_room) {
+        plan.action = DECISION_PIGGYBACK;
+    } else if (plan.pending_ms >= _max_defer_ms && _dot->getNextTxMs() == 0) {
+        // Answers are overdue and a channel is free
+        plan.action = DECISION_SEPARATE;
+    } else {
+        plan.action = DECISION_DEFER;
+    }
+
+    return plan;
+}
+
+int32_t MacAnswerPlanner::send(const std::vector<uint8_t>& data, bool blocking) {
+    uplink_plan plan = this->plan(data.size() > 0xFF ? 0xFF : data.size());
+    int32_t ret;
+
+    if (data.empty()) {
+        // Caller sends an empty uplink itself, answers ride along
+        plan.action = DECISION_NONE;
+    }
+
+    switch (plan.action) {
+        case DECISION_PIGGYBACK:
+            _stats.piggybacked++;
+            ret = _dot->send(data, blocking);
+            if (ret == mDot::MDOT_OK)
+                _piggybacked = true;
+            break;
+
+        case DECISION_SEPARATE:
+            // The answer uplink takes the channel, the caller retries the data
+            service();
+            ret = mDot::MDOT_NO_FREE_CHAN;
+            break;
+
+        case DECISION_DEFER: {
+            // Answers do not fit next to the data and the MAC would drop them. Only a
+            // blocking send can put them back, after a non-blocking send the uplink is
+            // still in flight and owns the buffer.
+            if (!blocking) {
+                ret = _dot->send(data, blocking);
+                break;
+            }
+
+            std::vector<uint8_t> answers = _dot->getMacCommands();
+            std::vector<uint8_t> keep;
+            std::vector<uint8_t> held;
+
+            for (size_t i = 0; i < answers.size(); ) {
+                uint8_t size = commandSize(answers[i]);
+
+                if (size == 0 || i + size > answers.size()) {
+                    // Unknown command, leave the rest to the MAC
+                    keep.insert(keep.end(), answers.begin() + i, answers.end());
+                    break;
+                }
+
+                std::vector<uint8_t>& to = isDeferrable(answers[i]) ? held : keep;
+                to.insert(to.end(), answers.begin() + i, answers.begin() + i + size);
+                i += size;
+            }
+
+            if (held.empty()) {
+                ret = _dot->send(data, blocking);
+                break;
+            }
+
+            _stats.deferred++;
+            _dot->clearMacCommands();
+            if (!keep.empty())
+                _dot->injectMacCommand(keep);
+
+            ret = _dot->send(data, blocking);
+
+            // Answers to commands repeated in the downlink of this uplink were added again
+            // by the MAC, only put back the ones still missing and only if they fit
+            std::vector<uint8_t> current = _dot->getMacCommands();
+            std::vector<uint8_t> restore;
+
+            for (size_t i = 0; i < held.size(); i += commandSize(held[i])) {
+                if (!hasCommand(current, held[i]))
+                    restore.insert(restore.end(), held.begin() + i, held.begin() + i + commandSize(held[i]));
+            }
+
+            if (current.size() + restore.size() > lora::COMMANDS_BUFFER_SIZE) {
+                logWarning("Dropping %d bytes of deferred MAC answers", (int) restore.size());
+            } else if (!restore.empty()) {
+                _dot->injectMacCommand(restore);
+            }
+            break;
+        }
+
+        default:
+            ret = _dot->send(data, blocking);
+            break;
+    }
+
+    track(_dot->getSettings()->Session.CommandBufferIndex);
+    return ret;
+}
+
+bool MacAnswerPlanner::service() {
+    DOT_STATS_TIME(SUBSYSTEM_MAC);
+    DOT_STATS_HEAP(SUBSYSTEM_MAC);
+
+    uplink_plan plan = this->plan(0);
+
+    if (plan.action != DECISION_SEPARATE)
+        return false;
+
+    logInfo("Sending %d bytes of MAC answers pending %lu ms", plan.mac_bytes, plan.pending_ms);
+
+    _stats.separate++;
+    if (_dot->send(std::vector<uint8_t>(), false) == mDot::MDOT_OK)
+        _separate = true;
+
+    track(_dot->getSettings()->Session.CommandBufferIndex);
+    return true;
+}
+
+void MacAnswerPlanner::setMaxDefer(uint32_t ms) {
+    _max_defer_ms = ms;
+}
+
+uint32_t MacAnswerPlanner::getMaxDefer() {
+    return _max_defer_ms;
+}
+
+MacAnswerPlanner::mac_answer_stats MacAnswerPlanner::getStats() {
+    return _stats;
+}
+
+void MacAnswerPlanner::track(uint8_t mac_bytes) {
+    if (mac_bytes == 0) {
+        if (_pending && _piggybacked && !_separate) {
+            // Answers left with application data and no empty uplink was needed
+            _stats.air_time_saved_ms += _dot->getTimeOnAir(_pending_bytes);
+        }
+        _pending = false;
+    } else if (!_pending) {
+        _pending = true;
+        _pending_since = Kernel::get_ms_count();
+        _piggybacked = false;
+        _separate = false;
+        _pending_bytes = mac_bytes;
+    } else if (mac_bytes > _pending_bytes) {
+        _pending_bytes = mac_bytes;
+    }
+}
+
+uint8_t MacAnswerPlanner::commandSize(uint8_t cid) {
+    switch (cid) {
+        case lora::MOTE_MAC_LINK_CHECK_REQ:
+        case lora::MOTE_MAC_DUTY_CYCLE_ANS:
+        case lora::MOTE_MAC_RX_TIMING_SETUP_ANS:
+        case lora::MOTE_MAC_TX_PARAM_SETUP_ANS:
+        case lora::MOTE_MAC_DEVICE_TIME_REQ:
+        case lora::MOTE_MAC_BEACON_TIMING_REQ:
+            return 1;
+        case lora::MOTE_MAC_LINK_ADR_ANS:
+        case lora::MOTE_MAC_RX_PARAM_SETUP_ANS:
+        case lora::MOTE_MAC_NEW_CHANNEL_ANS:
+        case lora::MOTE_MAC_DL_CHANNEL_ANS:
+        case lora::MOTE_MAC_PING_SLOT_INFO_REQ:
+        case lora::MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+        case lora::MOTE_MAC_BEACON_FREQ_ANS:
+            return 2;
+        case lora::MOTE_MAC_DEV_STATUS_ANS:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+bool MacAnswerPlanner::isDeferrable(uint8_t cid) {
+    switch (cid) {
+        case lora::MOTE_MAC_LINK_ADR_ANS:
+        case lora::MOTE_MAC_DUTY_CYCLE_ANS:
+        case lora::MOTE_MAC_DEV_STATUS_ANS:
+        case lora::MOTE_MAC_NEW_CHANNEL_ANS:
+        case lora::MOTE_MAC_TX_PARAM_SETUP_ANS:
+        case lora::MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+        case lora::MOTE_MAC_BEACON_FREQ_ANS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool MacAnswerPlanner::hasCommand(const std::vector<uint8_t>& commands, uint8_t cid) {
+    for (size_t i = 0; i < commands.size(); ) {
+        uint8_t size = commandSize(commands[i]);
+
+        if (commands[i] == cid)
+            return true;
+
+        // Unknown command, the rest of the buffer cannot be walked
+        if (size == 0)
+            return false;
+
+        i += size;
+    }
+
+    return false;
+}
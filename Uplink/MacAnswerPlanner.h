@@ -0,0 +1,101 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#ifndef _MAC_ANSWER_PLANNER_H
+#define _MAC_ANSWER_PLANNER_H
+#include "mDot.h"
+
+#define MAC_ANSWER_MAX_FOPTS 15             // bytes of MAC commands that fit in FOpts
+#define MAC_ANSWER_MAX_DEFER_MS 600000      // longest time answers wait for an application uplink
+
+// Decides per uplink how pending MAC answers in the session command buffer are sent.
+// Answers ride in FOpts of an application uplink when they fit next to the payload at
+// the current datarate. When they do not fit the MAC would drop them, so on blocking
+// sends the plain answers are held back and put back in the buffer once the uplink is
+// done. Requests of the application (LinkCheckReq, DeviceTimeReq) and sticky answers
+// (RxParamSetupAns, RxTimingSetupAns, DlChannelAns) always stay in the buffer. A
+// separate empty uplink is only planned once answers have waited longer than the
+// defer limit and a channel is free, so network reconfigurations no longer cost an
+// extra uplink each.
+class MacAnswerPlanner {
+    public:
+        enum decision {
+            DECISION_NONE,                  // no answers pending
+            DECISION_PIGGYBACK,             // answers fit in FOpts with the application payload
+            DECISION_DEFER,                 // keep answers for a later uplink
+            DECISION_SEPARATE               // send answers alone in an empty uplink
+        };
+
+        typedef struct {
+            decision action;
+            uint8_t mac_bytes;              // pending answer bytes
+            uint8_t max_payload;            // max payload at the current datarate without FOpts
+            uint8_t app_room;               // application bytes that fit next to the answers
+            uint32_t pending_ms;            // time answers have been pending
+        } uplink_plan;
+
+        typedef struct {
+            uint32_t piggybacked;
+            uint32_t deferred;
+            uint32_t separate;
+            uint32_t air_time_saved_ms;     // time on air of empty uplinks avoided by piggybacked answers
+        } mac_answer_stats;
+
+        MacAnswerPlanner(mDot* dot);
+        ~MacAnswerPlanner();
+
+        // Plan the next uplink, app_size is the size of pending application data or 0 if none
+        uplink_plan plan(uint8_t app_size);
+
+        // Send application data, answers are kept for later if they do not fit next to it
+        // and the send is blocking
+        // returns mDot error code, MDOT_NO_FREE_CHAN if overdue answers were sent alone
+        // first and the data was not sent, retry once getNextTxMs() returns 0
+        int32_t send(const std::vector<uint8_t>& data, bool blocking = true);
+
+        // Call when there is no application data, sends an empty uplink if answers are overdue
+        // returns true if an uplink was sent
+        bool service();
+
+        // Longest time answers wait for an application uplink before an empty uplink is sent
+        void setMaxDefer(uint32_t ms);
+        uint32_t getMaxDefer();
+
+        mac_answer_stats getStats();
+
+    private:
+        void track(uint8_t mac_bytes);
+
+        // Size of an uplink MAC command including CID, 0 if unknown
+        static uint8_t commandSize(uint8_t cid);
+
+        // Answers that are not requests of the application and not resent by the MAC
+        static bool isDeferrable(uint8_t cid);
+
+        // Check for a command in a MAC command buffer, only CIDs are compared and not payload bytes
+        static bool hasCommand(const std::vector<uint8_t>& commands, uint8_t cid);
+
+        mDot* _dot;
+        uint32_t _max_defer_ms;
+        uint64_t _pending_since;            // kernel ms count when answers were first seen pending
+        bool _pending;
+        bool _piggybacked;                  // pending answers went out with application data
+        bool _separate;                     // pending answers went out in an empty uplink
+        uint8_t _pending_bytes;             // most answer bytes pending at once
+        mac_answer_stats _stats;
+};
+#endif // _MAC_ANSWER_PLANNER_H
@@ -0,0 +1,195 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "AdrEngine.h"
+#include "ChannelPlan.h"
+
+using namespace lora;
+
+AdrEngine::AdrEngine(ChannelPlan* plan)
+:
+  _plan(plan),
+  _enabled(false),
+  _installMargin(ADR_ENGINE_DEFAULT_MARGIN)
+{
+    Reset();
+    _address = 0;
+}
+
+void AdrEngine::SetEnabled(bool enable) {
+    _enabled = enable;
+}
+
+bool AdrEngine::IsEnabled() {
+    return _enabled;
+}
+
+void AdrEngine::SetInstallationMargin(uint8_t margin) {
+    _installMargin = margin;
+}
+
+uint8_t AdrEngine::GetInstallationMargin() {
+    return _installMargin;
+}
+
+void AdrEngine::LinkCheck(uint8_t margin) {
+    _linkCheckMargin = margin;
+    _linkCheckPending = true;
+}
+
+void AdrEngine::NetworkAdr() {
+    if (_enabled && !_networkControl) {
+        logDebug("ADR engine yielding to network");
+    }
+
+    _networkControl = true;
+}
+
+void AdrEngine::Reset() {
+    _networkControl = false;
+    _linkCheckPending = false;
+    _linkCheckMargin = 0;
+    _lastDown = 0;
+    _datarate = 0xFF;
+    _power = 0xFF;
+}
+
+int16_t AdrEngine::RequiredSnr(uint8_t sf) {
+    // LoRa demodulator floor, -7.5 dB at SF7 and 2.5 dB lower per spreading factor
+    return -75 - ((int16_t) sf - SF_7) * 25;
+}
+
+bool AdrEngine::CanIncrementDatarate(uint8_t dr) {
+    if (dr >= _plan->GetMaxDatarate())
+        return false;
+
+    Datarate cur = _plan->GetDatarate(dr);
+    Datarate next = _plan->GetDatarate(dr + 1);
+
+    // Only step within LoRa datarates of the same bandwidth
+    if (next.SpreadingFactor == SF_FSK || next.SpreadingFactor >= cur.SpreadingFactor || next.Bandwidth != cur.Bandwidth)
+        return false;
+
+    if (_plan->GetMaxPayloadSize(dr + 1) == 0)
+        return false;
+
+    for (uint8_t i = 0; i < _plan->GetNumberOfChannels(); i++) {
+        DatarateRange range = _plan->GetChannel(i).DrRange;
+
+        if (_plan->IsChannelEnabled(i) && dr + 1 >= range.Fields.Min && dr + 1 <= range.Fields.Max)
+            return true;
+    }
+
+    return false;
+}
+
+int16_t AdrEngine::LinkMargin(const Datarate& dr) {
+    Statistics& stats = _plan->GetSettings()->Stats;
+    int16_t required = RequiredSnr(dr.SpreadingFactor);
+    int16_t margin;
+
+    if (_linkCheckPending) {
+        // Gateway reported demodulation margin of the uplink
+        margin = _linkCheckMargin * 10;
+    } else {
+        // Receiver sensitivity is -174 dBm/Hz + 10log(BW) + 6 dB noise figure + required SNR
+        int16_t bw = dr.Bandwidth == BW_500 ? 57 : dr.Bandwidth == BW_250 ? 54 : 51;
+        int16_t sensitivity = (-174 + bw + 6) * 10 + required;
+        int16_t snrMargin = stats.SnrAvg - required;
+        int16_t rssiMargin = stats.RssiMin * 10 - sensitivity;
+
+        margin = snrMargin < rssiMargin ? snrMargin : rssiMargin;
+    }
+
+    return margin - _installMargin * 10;
+}
+
+bool AdrEngine::Update() {
+    Settings* settings = _plan->GetSettings();
+
+    if (!_enabled || !settings->Network.ADREnabled || !settings->Session.Joined || _plan->P2PEnabled())
+        return false;
+
+    if (settings->Session.Address != _address) {
+        Reset();
+        _address = settings->Session.Address;
+        _lastDown = settings->Stats.Down;
+    }
+
+    if (_networkControl)
+        return false;
+
+    // Start from current session values, ADR backoff or the application may have changed them
+    _datarate = settings->Session.TxDatarate;
+    _power = settings->Session.TxPower;
+
+    // Link may be lost, leave it to ADR backoff
+    if (settings->Session.AdrCounter >= settings->Network.AdrAckLimit)
+        return false;
+
+    bool newDown = settings->Stats.Down != _lastDown && settings->Stats.AvgCount > 0;
+
+    if (!newDown && !_linkCheckPending)
+        return false;
+
+    _lastDown = settings->Stats.Down;
+
+    Datarate dr = _plan->GetDatarate(_datarate);
+
+    if (dr.SpreadingFactor == SF_FSK) {
+        _linkCheckPending = false;
+        return false;
+    }
+
+    int16_t margin = LinkMargin(dr);
+    int16_t steps = margin / (ADR_ENGINE_STEP_DB * 10);
+    _linkCheckPending = false;
+
+    uint8_t datarate = _datarate;
+    uint8_t power = _power;
+    uint8_t maxPower = settings->Network.TxPower;
+    uint8_t minPower = _plan->GetMinTxPower();
+
+    if (maxPower > minPower + ADR_ENGINE_MAX_POWER_STEPS * ADR_ENGINE_POWER_STEP)
+        minPower = maxPower - ADR_ENGINE_MAX_POWER_STEPS * ADR_ENGINE_POWER_STEP;
+
+    while (steps > 0 && CanIncrementDatarate(datarate)) {
+        datarate++;
+        steps--;
+    }
+
+    while (steps > 0 && power >= minPower + ADR_ENGINE_POWER_STEP) {
+        power -= ADR_ENGINE_POWER_STEP;
+        steps--;
+    }
+
+    // Margin below target, win it back with power the engine took away
+    while (steps < 0 && power + ADR_ENGINE_POWER_STEP <= maxPower) {
+        power += ADR_ENGINE_POWER_STEP;
+        steps++;
+    }
+
+    if (datarate == _datarate && power == _power)
+        return false;
+
+    logDebug("ADR engine margin: %d cB DR: %u -> %u PWR: %u -> %u", margin, _datarate, datarate, _power, power);
+
+    settings->Session.TxDatarate = _datarate = datarate;
+    settings->Session.TxPower = _power = power;
+
+    return true;
+}
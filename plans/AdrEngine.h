@@ -0,0 +1,115 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::AdrEngine provides device side adaptive datarate from measured link margin
+ *
+ * @details
+ *  Link margin is estimated from the rolling downlink SNR and minimum RSSI in
+ *  lora::Statistics or from the demodulation margin reported in LinkCheckAns.
+ *  Each 3 dB of margin above the installation margin raises the datarate one
+ *  step, remaining steps lower the tx power by 2 dB. The engine never lowers
+ *  the datarate, ADR backoff in the MAC is left in charge of that.
+ *
+ *  The engine only acts on new link measurements and stops adjusting the
+ *  session once the network sends a LinkADRReq changing datarate or power.
+ */
+
+#ifndef __ADR_ENGINE_H__
+#define __ADR_ENGINE_H__
+
+#include "Lora.h"
+
+namespace lora {
+
+    class ChannelPlan;
+
+    const uint8_t ADR_ENGINE_DEFAULT_MARGIN = 10;   //!< Default installation margin in dB
+    const uint8_t ADR_ENGINE_STEP_DB = 3;           //!< Link margin in dB used by each datarate or power step
+    const uint8_t ADR_ENGINE_POWER_STEP = 2;        //!< Change of tx power in dB per step
+    const uint8_t ADR_ENGINE_MAX_POWER_STEPS = 7;   //!< Max number of power steps below configured tx power
+
+    class AdrEngine {
+        public:
+
+            /**
+             * AdrEngine constructor
+             * @param plan ChannelPlan used for datarates, channels and settings
+             */
+            AdrEngine(ChannelPlan* plan);
+
+            /**
+             * Enable or disable the engine, disabled by default
+             * Network.ADREnabled must also be on for the engine to change datarate or power
+             */
+            void SetEnabled(bool enable);
+
+            /**
+             * Check if engine is enabled
+             */
+            bool IsEnabled();
+
+            /**
+             * Set the margin in dB kept above the demodulation floor
+             */
+            void SetInstallationMargin(uint8_t margin);
+
+            /**
+             * Get the margin in dB kept above the demodulation floor
+             */
+            uint8_t GetInstallationMargin();
+
+            /**
+             * Link margin reported by the network in LinkCheckAns
+             * @param margin demodulation margin of last uplink in dB
+             */
+            void LinkCheck(uint8_t margin);
+
+            /**
+             * Network has taken control of datarate or power with LinkADRReq
+             * Engine does not adjust the session until Reset or a new session is joined
+             */
+            void NetworkAdr();
+
+            /**
+             * Discard measurements and hand control back to the engine
+             */
+            void Reset();
+
+            /**
+             * Evaluate the latest link measurement before an uplink
+             * @return true if datarate or tx power was changed
+             */
+            bool Update();
+
+            /**
+             * Get the SNR needed to demodulate a spreading factor
+             * @param sf spreading factor
+             * @return SNR in cB
+             */
+            static int16_t RequiredSnr(uint8_t sf);
+
+        private:
+
+            bool CanIncrementDatarate(uint8_t dr);
+            int16_t LinkMargin(const Datarate& dr);
+
+            ChannelPlan* _plan;
+
+            bool _enabled;
+            bool _networkControl;               //!< Network sent LinkADRReq with datarate or power
+            bool _linkCheckPending;             //!< LinkCheckAns margin not yet used
+            uint8_t _linkCheckMargin;
+            uint8_t _installMargin;
+
+            uint32_t _address;                  //!< Session address, engine resets on new session
+            uint32_t _lastDown;                 //!< Downlink count of last measurement used
+            uint8_t _datarate;                  //!< Datarate last set or seen by the engine
+            uint8_t _power;                     //!< Tx power last set or seen by the engine
+    };
+}
+
+#endif // __ADR_ENGINE_H__
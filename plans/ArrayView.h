@@ -0,0 +1,60 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::ArrayView non-owning view of contiguous elements
+ *
+ * @details
+ *  Gives read access to channel plan storage without copying it into a new vector.
+ *  A view is only valid until the storage it refers to is changed.
+ */
+
+#ifndef __ARRAY_VIEW_H__
+#define __ARRAY_VIEW_H__
+
+#include <stddef.h>
+#include <vector>
+
+namespace lora {
+
+    template <typename T>
+    class ArrayView {
+        public:
+
+            /**
+             * Empty view
+             */
+            ArrayView() : _data(NULL), _size(0) {}
+
+            /**
+             * View of an array
+             * @param data first element
+             * @param size number of elements
+             */
+            ArrayView(const T* data, size_t size) : _data(data), _size(size) {}
+
+            /**
+             * View of the elements of a vector
+             * @param v vector, must not be resized while the view is used
+             */
+            ArrayView(const std::vector<T>& v) : _data(v.empty() ? NULL : &v[0]), _size(v.size()) {}
+
+            const T& operator[](size_t i) const { return _data[i]; }
+
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+
+            const T* begin() const { return _data; }
+            const T* end() const { return _data + _size; }
+
+        private:
+
+            const T* _data;
+            size_t _size;
+    };
+}
+
+#endif // __ARRAY_VIEW_H__
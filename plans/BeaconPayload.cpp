@@ -0,0 +1,55 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "BeaconPayload.h"
+#include "Crc16.h"
+#include "DotStats.h"
+
+using namespace lora;
+
+uint8_t lora::DecodeBeaconPayload(const uint8_t* payload, size_t size, uint8_t beaconSize, uint8_t rfu1, BeaconData_t& data) {
+    DOT_STATS_TIME(SUBSYSTEM_RX);
+
+    // First check the size of the packet
+    if (size != beaconSize || beaconSize < rfu1 + BEACON_TIME_SIZE + BEACON_GW_SPECIFIC_SIZE + 2 * BEACON_CRC_SIZE)
+        return LORA_BEACON_SIZE;
+
+    const uint8_t* time = payload + rfu1;
+    const uint8_t* crc1 = time + BEACON_TIME_SIZE;
+    const uint8_t* info = crc1 + BEACON_CRC_SIZE;
+    const uint8_t* crc2 = payload + beaconSize - BEACON_CRC_SIZE;
+
+    // Next we verify CRC1 is correct
+    if (Crc16::Compute(payload, crc1 - payload) != (crc1[0] | crc1[1] << 8))
+        return LORA_BEACON_CRC;
+
+    // Now that we have confirmed this packet is a beacon, parse and complete the output struct
+    memcpy(&data.Time, time, BEACON_TIME_SIZE);
+    data.InfoDesc = info[0];
+
+    // Update the GPS fields if we have a gps info descriptor and valid crc
+    if (Crc16::Compute(info, crc2 - info) == (crc2[0] | crc2[1] << 8) &&
+        (data.InfoDesc == GPS_FIRST_ANTENNA ||
+         data.InfoDesc == GPS_SECOND_ANTENNA ||
+         data.InfoDesc == GPS_THIRD_ANTENNA)) {
+        // Latitude and Longitude 3 bytes in length
+        memcpy(&data.Latitude, &info[1], 3);
+        memcpy(&data.Longitude, &info[4], 3);
+    }
+
+    return LORA_OK;
+}
@@ -0,0 +1,41 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ *
+ * @brief  lora::DecodeBeaconPayload shared class B beacon decoder
+ *
+ * @details
+ *  Beacons of all plans have the layout
+ *   RFU1 | Time(4) | CRC1(2) | GwSpecific(7) | RFU2 | CRC2(2)
+ *  and only differ in the length of the RFU fields. CRC1 covers RFU1 and Time,
+ *  CRC2 covers GwSpecific and RFU2. Both are computed with lora::Crc16.
+ */
+
+#ifndef __BEACON_PAYLOAD_H__
+#define __BEACON_PAYLOAD_H__
+
+#include "Lora.h"
+
+namespace lora {
+
+    const uint8_t BEACON_TIME_SIZE = 4;             //!< Bytes of beacon time
+    const uint8_t BEACON_CRC_SIZE = 2;              //!< Bytes of each beacon CRC
+    const uint8_t BEACON_GW_SPECIFIC_SIZE = 7;      //!< Bytes of gateway specific info
+
+    /**
+     * Check and decode a beacon
+     * @param payload received packet
+     * @param size of the packet
+     * @param beaconSize size of a beacon in the channel plan
+     * @param rfu1 bytes of RFU before the beacon time
+     * @param[out] data extracted from the beacon
+     * @return LORA_OK, LORA_BEACON_SIZE or LORA_BEACON_CRC
+     */
+    uint8_t DecodeBeaconPayload(const uint8_t* payload, size_t size, uint8_t beaconSize, uint8_t rfu1, BeaconData_t& data);
+}
+
+#endif // __BEACON_PAYLOAD_H__
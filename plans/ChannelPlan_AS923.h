@@ -40,6 +40,10 @@
 #include "SxRadio.h"
 #include <vector>
 #include "ChannelPlan.h"
+#include "ChannelSearch.h"
+#include "ChannelTable.h"
+#include "AdrEngine.h"
+#include "JoinHistory.h"
 
 namespace lora {
 
@@ -79,6 +83,26 @@ namespace lora {
              */
             virtual uint8_t GetNextChannel();
 
+            /**
+             * Set the event queue used by the plan and the background LBT channel search
+             */
+            virtual void SetEventQueue(EventQueue* queue);
+
+            /**
+             * Get the listen before talk channel search
+             */
+            ChannelSearch& GetChannelSearch();
+
+            /**
+             * Get the device side ADR engine
+             */
+            AdrEngine& GetAdrEngine();
+
+            /**
+             * Get the join history used to start joins with the last successful configuration
+             */
+            JoinHistory& GetJoinHistory();
+
             /**
              * Add a channel to the ChannelPlan
              * @param index of channel, use -1 to add to end
@@ -267,6 +291,12 @@ namespace lora {
 
         protected:
 
+            ChannelSearch _channelSearch;                               //!< Non-blocking listen before talk channel search
+            ChannelTable<AS923_125K_NUM_CHANS> _channelTable;           //!< Channel bitmaps per datarate for channel selection
+            AdrEngine _adrEngine;                                       //!< Device side adaptive datarate
+            JoinHistory _joinHistory;                                   //!< Join backoff state and last successful join configuration
+            uint8_t _joinDatarateCnt;                                   //!< Join attempts used to cycle join datarates
+
             static const uint8_t AS923_TX_POWERS[8];                    //!< List of available tx powers
             static const uint8_t AS923_RADIO_POWERS[21];                //!< List of calibrated tx powers
             static const uint8_t AS923_MAX_PAYLOAD_SIZE[];              //!< List of max payload sizes for each datarate
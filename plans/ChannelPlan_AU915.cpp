@@ -16,6 +16,8 @@
 ***********************************************************************/
 
 #include "ChannelPlan_AU915.h"
+#include "BeaconPayload.h"
+#include "DotStats.h"
 #include "limits.h"
 
 using namespace lora;
@@ -31,21 +33,30 @@ const uint8_t ChannelPlan_AU915::MAX_ERP_VALUES[] = { 8, 10, 12, 13, 14, 16, 18,
 
 ChannelPlan_AU915::ChannelPlan_AU915()
 :
-  ChannelPlan(NULL, NULL)
+  ChannelPlan(NULL, NULL),
+  _channelSearch(this),
+  _adrEngine(this),
+  _joinFsb(1)
 {
 
 }
 
 ChannelPlan_AU915::ChannelPlan_AU915(Settings* settings)
 :
-  ChannelPlan(NULL, settings)
+  ChannelPlan(NULL, settings),
+  _channelSearch(this),
+  _adrEngine(this),
+  _joinFsb(1)
 {
 
 }
 
 ChannelPlan_AU915::ChannelPlan_AU915(SxRadio* radio, Settings* settings)
 :
-  ChannelPlan(radio, settings)
+  ChannelPlan(radio, settings),
+  _channelSearch(this),
+  _adrEngine(this),
+  _joinFsb(1)
 {
 
 }
@@ -54,6 +65,23 @@ ChannelPlan_AU915::~ChannelPlan_AU915() {
 
 }
 
+void ChannelPlan_AU915::SetEventQueue(EventQueue* queue) {
+    ChannelPlan::SetEventQueue(queue);
+    _channelSearch.SetEventQueue(queue);
+}
+
+ChannelSearch& ChannelPlan_AU915::GetChannelSearch() {
+    return _channelSearch;
+}
+
+AdrEngine& ChannelPlan_AU915::GetAdrEngine() {
+    return _adrEngine;
+}
+
+JoinHistory& ChannelPlan_AU915::GetJoinHistory() {
+    return _joinHistory;
+}
+
 void ChannelPlan_AU915::Init() {
     _plan = AU915;
     _planName = "AU915";
@@ -62,6 +90,10 @@ void ChannelPlan_AU915::Init() {
     _channels.clear();
     _dutyBands.clear();
 
+#if defined(CHANNEL_PLAN_STATIC_MEMORY)
+    ReserveStorage(AU915_125K_NUM_CHANS + AU915_500K_NUM_CHANS, 0);
+#endif
+
     DutyBand band;
 
     band.Index = 0;
@@ -163,6 +195,8 @@ void ChannelPlan_AU915::Init() {
 
     SetFrequencySubBand(GetSettings()->Network.FrequencySubBand);
 
+
+    _channelTable.Invalidate();
 }
 
 uint8_t ChannelPlan_AU915::HandleJoinAccept(const uint8_t* buffer, uint8_t size) {
@@ -173,6 +207,8 @@ uint8_t ChannelPlan_AU915::HandleJoinAccept(const uint8_t* buffer, uint8_t size)
         }
     }
 
+    _joinHistory.Joined();
+
     return LORA_OK;
 }
 
@@ -185,6 +221,7 @@ void ChannelPlan_AU915::SetNumberOfChannels(uint8_t channels, bool resize) {
 
     _channelMask.resize(newsize, 0x0);
     _numChans = channels;
+    _channelTable.Invalidate();
 
 }
 
@@ -232,16 +269,17 @@ uint8_t ChannelPlan_AU915::SetRx2DatarateIndex(uint8_t index) {
 }
 
 uint8_t ChannelPlan_AU915::SetTxConfig() {
+    Settings* settings = GetSettings();
 
     uint8_t band = GetDutyBand(GetChannel(_txChannel).Frequency);
-    Datarate txDr = GetDatarate(GetSettings()->Session.TxDatarate);
+    Datarate txDr = GetDatarate(settings->Session.TxDatarate);
     int8_t max_pwr = _dutyBands[band].PowerMax;
 
     int8_t pwr = 0;
 
-    pwr = std::min < int8_t > (GetSettings()->Session.TxPower, max_pwr);
-    if (pwr + GetSettings()->Network.AntennaGain >= max_pwr + 6 && GetSettings()->Network.AntennaGain > 6) {
-        pwr -= (GetSettings()->Network.AntennaGain - 6);
+    pwr = std::min < int8_t > (settings->Session.TxPower, max_pwr);
+    if (pwr + settings->Network.AntennaGain >= max_pwr + 6 && settings->Network.AntennaGain > 6) {
+        pwr -= (settings->Network.AntennaGain - 6);
     }
 
     for (int i = 20; i >= 0; i--) {
@@ -254,8 +292,8 @@ uint8_t ChannelPlan_AU915::SetTxConfig() {
         }
     }
 
-    logDebug("Session pwr: %d ant: %d max: %d", GetSettings()->Session.TxPower, GetSettings()->Network.AntennaGain, max_pwr);
-    logDebug("Radio Power index: %d output: %d total: %d", pwr, RADIO_POWERS[pwr], RADIO_POWERS[pwr] + GetSettings()->Network.AntennaGain);
+    logDebug("Session pwr: %d ant: %d max: %d", settings->Session.TxPower, settings->Network.AntennaGain, max_pwr);
+    logDebug("Radio Power index: %d output: %d total: %d", pwr, RADIO_POWERS[pwr], RADIO_POWERS[pwr] + settings->Network.AntennaGain);
 
     uint32_t bw = txDr.Bandwidth;
     uint32_t sf = txDr.SpreadingFactor;
@@ -265,7 +303,7 @@ uint8_t ChannelPlan_AU915::SetTxConfig() {
     bool crc = txDr.Crc;
     bool iq = txDr.TxIQ;
 
-    if (GetSettings()->Network.DisableCRC == true)
+    if (settings->Network.DisableCRC == true)
         crc = false;
 
     SxRadio::RadioModems_t modem = SxRadio::MODEM_LORA;
@@ -296,6 +334,8 @@ uint8_t ChannelPlan_AU915::AddChannel(int8_t index, Channel channel) {
         _channels.push_back(channel);
     }
 
+    _channelTable.Invalidate();
+
     return LORA_OK;
 }
 
@@ -608,13 +648,20 @@ uint8_t ChannelPlan_AU915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
 
     uint16_t t_125k = 0; //used only in ctrl case 5
 
+    // Stage the new mask, only words that change are written back
+    uint16_t masks[5];
+
+    for (uint8_t i = 0; i < 5; i++) {
+        masks[i] = i < _channelMask.size() ? _channelMask[i] : 0;
+    }
+
     switch (ctrl) {
         case 0:
         case 1:
         case 2:
         case 3:
         case 4:
-            SetChannelMask(ctrl, mask);
+            masks[ctrl] = mask;
             break;
 
         case 5:
@@ -624,11 +671,11 @@ uint8_t ChannelPlan_AU915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
                         t_125k |= (0xff << ((i % 2) * 8));
                     }
                     if(i % 2 == 1) {
-                        SetChannelMask(i/2, t_125k);
+                        masks[i/2] = t_125k;
                         t_125k = 0;
                     }
                 }
-                SetChannelMask(4, mask);
+                masks[4] = mask;
             } else {
                 status &= 0xFE; // ChannelMask KO
                 logWarning("Rejecting mask, will not disable all channels");
@@ -638,20 +685,20 @@ uint8_t ChannelPlan_AU915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
 
         case 6:
             // enable all 125 kHz channels
-            SetChannelMask(0, 0xFFFF);
-            SetChannelMask(1, 0xFFFF);
-            SetChannelMask(2, 0xFFFF);
-            SetChannelMask(3, 0xFFFF);
-            SetChannelMask(4, mask);
+            masks[0] = 0xFFFF;
+            masks[1] = 0xFFFF;
+            masks[2] = 0xFFFF;
+            masks[3] = 0xFFFF;
+            masks[4] = mask;
             break;
 
         case 7:
             // disable all 125 kHz channels
-            SetChannelMask(0, 0x0);
-            SetChannelMask(1, 0x0);
-            SetChannelMask(2, 0x0);
-            SetChannelMask(3, 0x0);
-            SetChannelMask(4, mask);
+            masks[0] = 0x0;
+            masks[1] = 0x0;
+            masks[2] = 0x0;
+            masks[3] = 0x0;
+            masks[4] = mask;
             break;
 
         default:
@@ -660,8 +707,15 @@ uint8_t ChannelPlan_AU915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
             return LORA_ERROR;
     }
 
+    for (uint8_t i = 0; i < 5; i++) {
+        if (i >= _channelMask.size() || masks[i] != _channelMask[i])
+            SetChannelMask(i, masks[i]);
+    }
+
     if (GetSettings()->Network.ADREnabled) {
         if (status == 0x07) {
+            if (datarate != 0xF || power != 0xF)
+                _adrEngine.NetworkAdr();
             if (datarate != 0xF)
                 GetSettings()->Session.TxDatarate = datarate;
             if (power != 0xF)
@@ -715,21 +769,23 @@ uint8_t ChannelPlan_AU915::ValidateAdrConfiguration() {
 
 uint32_t ChannelPlan_AU915::GetTimeOffAir()
 {
-    if (GetSettings()->Test.DisableDutyCycle == lora::ON)
+    Settings* settings = GetSettings();
+
+    if (settings->Test.DisableDutyCycle == lora::ON)
         return 0;
 
     uint32_t min = 0;
     uint32_t now = _dutyCycleTimer.read_ms();
 
-    if (GetSettings()->Session.AggregatedTimeOffEnd > 0 && GetSettings()->Session.AggregatedTimeOffEnd > now) {
-        min = std::max < uint32_t > (min, GetSettings()->Session.AggregatedTimeOffEnd - now);
+    if (settings->Session.AggregatedTimeOffEnd > 0 && settings->Session.AggregatedTimeOffEnd > now) {
+        min = std::max < uint32_t > (min, settings->Session.AggregatedTimeOffEnd - now);
     }
 
     now = time(NULL);
     uint32_t join_time = 0;
 
-    if (GetSettings()->Session.JoinFirstAttempt != 0 && now < GetSettings()->Session.JoinTimeOffEnd) {
-        join_time = (GetSettings()->Session.JoinTimeOffEnd - now) * 1000;
+    if (settings->Session.JoinFirstAttempt != 0 && now < settings->Session.JoinTimeOffEnd) {
+        join_time = (settings->Session.JoinTimeOffEnd - now) * 1000;
     }
 
     min = std::max < uint32_t > (join_time, min);
@@ -788,29 +844,35 @@ void lora::ChannelPlan_AU915::EnableDefaultChannels() {
 
 uint8_t ChannelPlan_AU915::GetNextChannel()
 {
-    if (GetSettings()->Session.AggregatedTimeOffEnd != 0) {
+    DOT_STATS_TIME(SUBSYSTEM_PLAN);
+
+    Settings* settings = GetSettings();
+
+    if (settings->Session.AggregatedTimeOffEnd != 0) {
         return LORA_AGGREGATED_DUTY_CYCLE;
     }
 
-    if (P2PEnabled() || GetSettings()->Network.TxFrequency != 0) {
-        logDebug("Using frequency %d", GetSettings()->Network.TxFrequency);
+    if (P2PEnabled() || settings->Network.TxFrequency != 0) {
+        logDebug("Using frequency %d", settings->Network.TxFrequency);
 
-        if (GetSettings()->Test.DisableDutyCycle != lora::ON) {
-            int8_t band = GetDutyBand(GetSettings()->Network.TxFrequency);
-            logDebug("band: %d freq: %d", band, GetSettings()->Network.TxFrequency);
+        if (settings->Test.DisableDutyCycle != lora::ON) {
+            int8_t band = GetDutyBand(settings->Network.TxFrequency);
+            logDebug("band: %d freq: %d", band, settings->Network.TxFrequency);
             if (band != -1 && _dutyBands[band].TimeOffEnd != 0) {
                 return LORA_NO_CHANS_ENABLED;
             }
         }
 
-        GetRadio()->SetChannel(GetSettings()->Network.TxFrequency);
+        GetRadio()->SetChannel(settings->Network.TxFrequency);
         return LORA_OK;
     }
 
+    _adrEngine.Update();
+
     uint8_t start = 0;
     uint8_t maxChannels = _numChans125k;
     uint8_t nbEnabledChannels = 0;
-    uint8_t *enabledChannels = new uint8_t[maxChannels];
+    uint8_t enabledChannels[AU915_125K_NUM_CHANS];
 
     if (GetTxDatarate().Bandwidth == BW_500) {
         maxChannels = _numChans500k;
@@ -818,28 +880,17 @@ uint8_t ChannelPlan_AU915::GetNextChannel()
     }
 
 // Search how many channels are enabled
-    DatarateRange range;
-    uint8_t dr_index = GetSettings()->Session.TxDatarate;
+    uint8_t dr_index = settings->Session.TxDatarate;
     uint32_t now = _dutyCycleTimer.read_ms();
 
     for (size_t i = 0; i < _dutyBands.size(); i++) {
-        if (_dutyBands[i].TimeOffEnd < now || GetSettings()->Test.DisableDutyCycle == lora::ON) {
+        if (_dutyBands[i].TimeOffEnd < now || settings->Test.DisableDutyCycle == lora::ON) {
             _dutyBands[i].TimeOffEnd = 0;
         }
     }
 
-    for (uint8_t i = start; i < start + maxChannels; i++) {
-        range = GetChannel(i).DrRange;
-        // logDebug("chan: %d freq: %d range:%02x", i, GetChannel(i).Frequency, range.Value);
-
-        if (IsChannelEnabled(i) && (dr_index >= range.Fields.Min && dr_index <= range.Fields.Max)) {
-            int8_t band = GetDutyBand(GetChannel(i).Frequency);
-            // logDebug("band: %d freq: %d", band, _channels[i].Frequency);
-            if (band != -1 && _dutyBands[band].TimeOffEnd == 0) {
-                enabledChannels[nbEnabledChannels++] = i;
-            }
-        }
-    }
+    _channelTable.Sync(this);
+    nbEnabledChannels = _channelTable.Select(dr_index, GetChannelMaskView(), start, start + maxChannels, _dutyBands, enabledChannels);
 
     if (GetTxDatarate().Bandwidth == BW_500) {
         _dutyBands[0].PowerMax = 26;
@@ -853,27 +904,18 @@ uint8_t ChannelPlan_AU915::GetNextChannel()
     logTrace("Number of available channels: %d", nbEnabledChannels);
 
     uint32_t freq = 0;
-    int16_t thres = DEFAULT_FREE_CHAN_RSSI_THRESHOLD;
 
     if (nbEnabledChannels == 0) {
-        delete [] enabledChannels;
         return LORA_NO_CHANS_ENABLED;
     }
 
-    if (GetSettings()->Network.CADEnabled) {
-        // Search for free channel with ms timeout
-        int16_t timeout = 10000;
-        Timer tmr;
-        tmr.start();
-
-        for (uint8_t j = rand_r(0, nbEnabledChannels - 1); tmr.read_ms() < timeout; j++) {
-            freq = GetChannel(enabledChannels[j]).Frequency;
-
-            if (GetRadio()->IsChannelFree(SxRadio::MODEM_LORA, freq, thres)) {
-                _txChannel = enabledChannels[j];
-                break;
-            }
+    if (settings->Network.CADEnabled) {
+        // Listen before talk on least occupied channels, search continues in the background if all are busy
+        if (_channelSearch.Select(enabledChannels, nbEnabledChannels, _txChannel) != LORA_OK) {
+            return LORA_LBT_CHANNEL_BUSY;
         }
+
+        freq = GetChannel(_txChannel).Frequency;
     } else {
         uint8_t j = rand_r(0, nbEnabledChannels - 1);
         _txChannel = enabledChannels[j];
@@ -885,32 +927,38 @@ uint8_t ChannelPlan_AU915::GetNextChannel()
     logDebug("Using channel %d : %d", _txChannel, freq);
     GetRadio()->SetChannel(freq);
 
-    delete [] enabledChannels;
     return LORA_OK;
 }
 
 uint8_t lora::ChannelPlan_AU915::GetJoinDatarate() {
     uint8_t dr = GetSettings()->Session.TxDatarate;
-    static uint8_t fsb = 1;
-    static uint8_t dr4_fsb = 1;
-    static bool altdr = false;
+    uint8_t learned_dr = 0;
+    uint8_t sub_band = 0;
 
     dr = lora::DR_2;
 
     if (GetSettings()->Test.DisableRandomJoinDatarate == lora::OFF) {
 
-        if (GetSettings()->Network.FrequencySubBand == 0) {
-            SetFrequencySubBand(fsb);
-            logDebug("JoinDatarate setting frequency sub band to %d",fsb);
-
-            if (fsb < 8) {
-                fsb++;
+        if (_joinHistory.GetLearned(_maxDatarate, GetSettings()->Network.FrequencySubBand, sub_band, learned_dr)) {
+            if (sub_band != 0) {
+                SetFrequencySubBand(sub_band);
+            }
+            logDebug("JoinDatarate using learned sub band %d datarate %d", sub_band, learned_dr);
+            dr = learned_dr;
+        } else if (GetSettings()->Network.FrequencySubBand == 0) {
+            SetFrequencySubBand(_joinFsb);
+            logDebug("JoinDatarate setting frequency sub band to %d",_joinFsb);
+
+            if (_joinFsb < 8) {
+                _joinFsb++;
             } else {
-                fsb = 1;
+                _joinFsb = 1;
             }
         }
     }
 
+    _joinHistory.Attempt(_txFrequencySubBand, dr);
+
     return dr;
 }
 
@@ -918,11 +966,11 @@ uint8_t lora::ChannelPlan_AU915::CalculateJoinBackoff(uint8_t size) {
 
     time_t now = time(NULL);
     uint32_t time_on_max = 0;
-    static uint32_t time_off_max = 15;
+    uint32_t& time_off_max = _joinHistory.Get().TimeOffMax;
     uint32_t rand_time_off = 0;
-    static uint16_t join_cnt = 0;
+    uint16_t& join_cnt = _joinHistory.Get().JoinCount;
 
-    // TODO: calc time-off-max based on RTC time from JoinFirstAttempt, time-off-max is lost over sleep
+    _joinHistory.Restore(GetSettings());
 
     if ((time_t)GetSettings()->Session.JoinTimeOffEnd > now) {
         return LORA_JOIN_BACKOFF;
@@ -999,6 +1047,8 @@ uint8_t lora::ChannelPlan_AU915::CalculateJoinBackoff(uint8_t size) {
         GetSettings()->Session.JoinTimeOffEnd = now + rand_r(GetSettings()->Network.JoinDelay + 2, GetSettings()->Network.JoinDelay + 3);
     }
 
+    _joinHistory.Backoff(GetSettings());
+
     return LORA_OK;
 }
 
@@ -1041,38 +1091,7 @@ uint8_t ChannelPlan_AU915::HandleMacCommand(uint8_t* payload, uint8_t& index) {
 }
 
 uint8_t ChannelPlan_AU915::DecodeBeacon(const uint8_t* payload, size_t size, BeaconData_t& data) {
-    uint16_t crc1, crc1_rx, crc2, crc2_rx;
-    const BCNPayload* beacon = (const BCNPayload*)payload;
-
-    // First check the size of the packet
-    if (size != sizeof(BCNPayload))
-        return LORA_BEACON_SIZE;
-
-    // Next we verify CRC1 is correct
-    crc1 = CRC16(beacon->RFU1, sizeof(beacon->RFU1) + sizeof(beacon->Time));
-    memcpy((uint8_t*)&crc1_rx, beacon->CRC1, sizeof(uint16_t));
-
-    if (crc1 != crc1_rx)
-        return LORA_BEACON_CRC;
-
-    // Now that we have confirmed this packet is a beacon, parse and complete the output struct
-    memcpy(&data.Time, beacon->Time, sizeof(beacon->Time));
-    data.InfoDesc = beacon->GwSpecific[0];
-
-    crc2 = CRC16(beacon->GwSpecific, sizeof(beacon->GwSpecific) + sizeof(beacon->RFU2));
-    memcpy((uint8_t*)&crc2_rx, beacon->CRC2, sizeof(uint16_t));
-
-    // Update the GPS fields if we have a gps info descriptor and valid crc
-    if (crc2 == crc2_rx &&
-        (data.InfoDesc == GPS_FIRST_ANTENNA ||
-         data.InfoDesc == GPS_SECOND_ANTENNA ||
-         data.InfoDesc == GPS_THIRD_ANTENNA)) {
-        // Latitude and Longitude 3 bytes in length
-        memcpy(&data.Latitude, &beacon->GwSpecific[1], 3);
-        memcpy(&data.Longitude, &beacon->GwSpecific[4], 3);
-    }
-
-    return LORA_OK;
+    return DecodeBeaconPayload(payload, size, _beaconSize, offsetof(BCNPayload, Time), data);
 }
 
 void ChannelPlan_AU915::FrequencyHop(uint32_t time, uint32_t period, uint32_t devAddr) {
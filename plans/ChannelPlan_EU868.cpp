@@ -16,6 +16,8 @@
 ***********************************************************************/
 
 #include "ChannelPlan_EU868.h"
+#include "BeaconPayload.h"
+#include "DotStats.h"
 #include "limits.h"
 
 using namespace lora;
@@ -28,21 +30,30 @@ const uint8_t ChannelPlan_EU868::EU868_MAX_PAYLOAD_SIZE_REPEATER[] = { 51, 51, 5
 
 ChannelPlan_EU868::ChannelPlan_EU868()
 :
-    ChannelPlan(NULL, NULL)
+    ChannelPlan(NULL, NULL),
+    _channelSearch(this),
+    _adrEngine(this),
+    _joinDatarateCnt(0)
 {
 
 }
 
 ChannelPlan_EU868::ChannelPlan_EU868(Settings* settings)
 :
-    ChannelPlan(NULL, settings)
+    ChannelPlan(NULL, settings),
+    _channelSearch(this),
+    _adrEngine(this),
+    _joinDatarateCnt(0)
 {
 
 }
 
 ChannelPlan_EU868::ChannelPlan_EU868(SxRadio* radio, Settings* settings)
 :
-    ChannelPlan(radio, settings)
+    ChannelPlan(radio, settings),
+    _channelSearch(this),
+    _adrEngine(this),
+    _joinDatarateCnt(0)
 {
 
 }
@@ -51,12 +62,33 @@ ChannelPlan_EU868::~ChannelPlan_EU868() {
 
 }
 
+void ChannelPlan_EU868::SetEventQueue(EventQueue* queue) {
+    ChannelPlan::SetEventQueue(queue);
+    _channelSearch.SetEventQueue(queue);
+}
+
+ChannelSearch& ChannelPlan_EU868::GetChannelSearch() {
+    return _channelSearch;
+}
+
+AdrEngine& ChannelPlan_EU868::GetAdrEngine() {
+    return _adrEngine;
+}
+
+JoinHistory& ChannelPlan_EU868::GetJoinHistory() {
+    return _joinHistory;
+}
+
 void ChannelPlan_EU868::Init() {
 
     _datarates.clear();
     _channels.clear();
     _dutyBands.clear();
 
+#if defined(CHANNEL_PLAN_STATIC_MEMORY)
+    ReserveStorage(EU868_125K_NUM_CHANS, 16);
+#endif
+
     DutyBand band;
 
     band.Index = 0;
@@ -215,6 +247,8 @@ void ChannelPlan_EU868::Init() {
     AddDutyBand(-1, band);
 
     GetSettings()->Session.TxPower = GetSettings()->Network.TxPower;
+
+    _channelTable.Invalidate();
 }
 
 uint8_t ChannelPlan_EU868::AddChannel(int8_t index, Channel channel) {
@@ -228,6 +262,8 @@ uint8_t ChannelPlan_EU868::AddChannel(int8_t index, Channel channel) {
         _channels.push_back(channel);
     }
 
+    _channelTable.Invalidate();
+
     return LORA_OK;
 }
 
@@ -256,19 +292,22 @@ uint8_t ChannelPlan_EU868::HandleJoinAccept(const uint8_t* buffer, uint8_t size)
         }
     }
 
+    _joinHistory.Joined();
+
     return LORA_OK;
 }
 
 uint8_t ChannelPlan_EU868::SetTxConfig() {
+    Settings* settings = GetSettings();
 
     uint8_t band = GetDutyBand(GetChannel(_txChannel).Frequency);
-    Datarate txDr = GetDatarate(GetSettings()->Session.TxDatarate);
+    Datarate txDr = GetDatarate(settings->Session.TxDatarate);
     int8_t max_pwr = _dutyBands[band].PowerMax;
 
     int8_t pwr = 0;
 
-    pwr = std::min < int8_t > (GetSettings()->Session.TxPower, max_pwr);
-    pwr -= GetSettings()->Network.AntennaGain;
+    pwr = std::min < int8_t > (settings->Session.TxPower, max_pwr);
+    pwr -= settings->Network.AntennaGain;
 
     for (int i = 20; i >= 0; i--) {
         if (RADIO_POWERS[i] <= pwr) {
@@ -280,8 +319,8 @@ uint8_t ChannelPlan_EU868::SetTxConfig() {
         }
     }
 
-    logDebug("Session pwr: %d ant: %d max: %d", GetSettings()->Session.TxPower, GetSettings()->Network.AntennaGain, max_pwr);
-    logDebug("Radio Power index: %d output: %d total: %d", pwr, RADIO_POWERS[pwr], RADIO_POWERS[pwr] + GetSettings()->Network.AntennaGain);
+    logDebug("Session pwr: %d ant: %d max: %d", settings->Session.TxPower, settings->Network.AntennaGain, max_pwr);
+    logDebug("Radio Power index: %d output: %d total: %d", pwr, RADIO_POWERS[pwr], RADIO_POWERS[pwr] + settings->Network.AntennaGain);
 
     uint32_t bw = txDr.Bandwidth;
     uint32_t sf = txDr.SpreadingFactor;
@@ -291,7 +330,7 @@ uint8_t ChannelPlan_EU868::SetTxConfig() {
     bool crc = txDr.Crc;
     bool iq = txDr.TxIQ;
 
-    if (GetSettings()->Network.DisableCRC == true)
+    if (settings->Network.DisableCRC == true)
         crc = false;
 
     SxRadio::RadioModems_t modem = SxRadio::MODEM_LORA;
@@ -602,6 +641,8 @@ uint8_t ChannelPlan_EU868::HandleAdrCommand(const uint8_t* payload, uint8_t inde
 
     if (GetSettings()->Network.ADREnabled) {
         if (status == 0x07) {
+            if (datarate != 0xF || power != 0xF)
+                _adrEngine.NetworkAdr();
             if (datarate != 0xF)
                 GetSettings()->Session.TxDatarate = datarate;
             if (power != 0xF)
@@ -633,12 +674,10 @@ uint8_t ChannelPlan_EU868::ValidateAdrConfiguration() {
         }
     }
     // mask must not contain any undefined channels
-    for (int i = 3; i < 16; i++) {
-        if ((_channelMask[0] & (1 << i)) && (_channels[i].Frequency == 0)) {
-            logWarning("ADR Channel Mask KO - cannot enable undefined channel");
-            status &= 0xFE; // ChannelMask KO
-            break;
-        }
+    _channelTable.Sync(this);
+    if (_channelTable.EnablesUndefined(GetChannelMaskView(), 3, 16)) {
+        logWarning("ADR Channel Mask KO - cannot enable undefined channel");
+        status &= 0xFE; // ChannelMask KO
     }
 
     return status;
@@ -646,7 +685,9 @@ uint8_t ChannelPlan_EU868::ValidateAdrConfiguration() {
 
 uint32_t ChannelPlan_EU868::GetTimeOffAir()
 {
-    if (GetSettings()->Test.DisableDutyCycle == lora::ON)
+    Settings* settings = GetSettings();
+
+    if (settings->Test.DisableDutyCycle == lora::ON)
         return 0;
 
     uint32_t min = 0;
@@ -657,7 +698,7 @@ uint32_t ChannelPlan_EU868::GetTimeOffAir()
     int8_t band = 0;
 
     if (P2PEnabled()) {
-        int8_t band = GetDutyBand(GetSettings()->Network.TxFrequency);
+        int8_t band = GetDutyBand(settings->Network.TxFrequency);
         if (_dutyBands[band].TimeOffEnd > now) {
             min = _dutyBands[band].TimeOffEnd - now;
         } else {
@@ -666,8 +707,8 @@ uint32_t ChannelPlan_EU868::GetTimeOffAir()
     } else {
         for (size_t i = 0; i < _channels.size(); i++) {
             if (IsChannelEnabled(i) && GetChannel(i).Frequency != 0 &&
-                !(GetSettings()->Session.TxDatarate < GetChannel(i).DrRange.Fields.Min ||
-                  GetSettings()->Session.TxDatarate > GetChannel(i).DrRange.Fields.Max)) {
+                !(settings->Session.TxDatarate < GetChannel(i).DrRange.Fields.Min ||
+                  settings->Session.TxDatarate > GetChannel(i).DrRange.Fields.Max)) {
 
                 band = GetDutyBand(GetChannel(i).Frequency);
                 if (band != -1) {
@@ -684,15 +725,15 @@ uint32_t ChannelPlan_EU868::GetTimeOffAir()
     }
 
 
-    if (GetSettings()->Session.AggregatedTimeOffEnd > 0 && GetSettings()->Session.AggregatedTimeOffEnd > now) {
-        min = std::max < uint32_t > (min, GetSettings()->Session.AggregatedTimeOffEnd - now);
+    if (settings->Session.AggregatedTimeOffEnd > 0 && settings->Session.AggregatedTimeOffEnd > now) {
+        min = std::max < uint32_t > (min, settings->Session.AggregatedTimeOffEnd - now);
     }
 
     now = time(NULL);
     uint32_t join_time = 0;
 
-    if (GetSettings()->Session.JoinFirstAttempt != 0 && now < GetSettings()->Session.JoinTimeOffEnd) {
-        join_time = (GetSettings()->Session.JoinTimeOffEnd - now) * 1000;
+    if (settings->Session.JoinFirstAttempt != 0 && now < settings->Session.JoinTimeOffEnd) {
+        join_time = (settings->Session.JoinTimeOffEnd - now) * 1000;
     }
 
     min = std::max < uint32_t > (join_time, min);
@@ -702,7 +743,9 @@ uint32_t ChannelPlan_EU868::GetTimeOffAir()
 
 
 void ChannelPlan_EU868::UpdateDutyCycle(uint32_t freq, uint32_t time_on_air_ms) {
-    if (GetSettings()->Test.DisableDutyCycle == lora::ON) {
+    Settings* settings = GetSettings();
+
+    if (settings->Test.DisableDutyCycle == lora::ON) {
         _dutyCycleTimer.stop();
         for (size_t i = 0; i < _dutyBands.size(); i++) {
             _dutyBands[i].TimeOffEnd = 0;
@@ -712,11 +755,11 @@ void ChannelPlan_EU868::UpdateDutyCycle(uint32_t freq, uint32_t time_on_air_ms)
 
     _dutyCycleTimer.start();
 
-    if (GetSettings()->Session.MaxDutyCycle > 0 && GetSettings()->Session.MaxDutyCycle <= 15) {
-        GetSettings()->Session.AggregatedTimeOffEnd = _dutyCycleTimer.read_ms() + time_on_air_ms * GetSettings()->Session.AggregateDutyCycle;
-        logDebug("Updated Aggregate DCycle Time-off: %lu DC: %f", GetSettings()->Session.AggregatedTimeOffEnd, 1 / float(GetSettings()->Session.AggregateDutyCycle));
+    if (settings->Session.MaxDutyCycle > 0 && settings->Session.MaxDutyCycle <= 15) {
+        settings->Session.AggregatedTimeOffEnd = _dutyCycleTimer.read_ms() + time_on_air_ms * settings->Session.AggregateDutyCycle;
+        logDebug("Updated Aggregate DCycle Time-off: %lu DC: %f", settings->Session.AggregatedTimeOffEnd, 1 / float(settings->Session.AggregateDutyCycle));
     } else {
-        GetSettings()->Session.AggregatedTimeOffEnd = 0;
+        settings->Session.AggregatedTimeOffEnd = 0;
     }
 
 
@@ -733,7 +776,7 @@ void ChannelPlan_EU868::UpdateDutyCycle(uint32_t freq, uint32_t time_on_air_ms)
         if (freq >= _dutyBands[i].FrequencyMin && freq <= _dutyBands[i].FrequencyMax) {
             logDebug("update TOE: freq: %d i:%d toa: %d DC:%d", freq, i, time_on_air_ms, _dutyBands[i].DutyCycle);
 
-            if (freq > EU868_VAR_FREQ_MIN && freq < EU868_VAR_FREQ_MAX && (GetSettings()->Session.TxPower + GetSettings()->Network.AntennaGain) <= 7) {
+            if (freq > EU868_VAR_FREQ_MIN && freq < EU868_VAR_FREQ_MAX && (settings->Session.TxPower + settings->Network.AntennaGain) <= 7) {
                 _dutyBands[i].TimeOffEnd = 0;
             } else {
                 time_off_air = time_on_air_ms * _dutyBands[i].DutyCycle;
@@ -776,29 +819,35 @@ void lora::ChannelPlan_EU868::EnableDefaultChannels() {
 
 uint8_t ChannelPlan_EU868::GetNextChannel()
 {
-    if (GetSettings()->Session.AggregatedTimeOffEnd != 0) {
+    DOT_STATS_TIME(SUBSYSTEM_PLAN);
+
+    Settings* settings = GetSettings();
+
+    if (settings->Session.AggregatedTimeOffEnd != 0) {
         return LORA_AGGREGATED_DUTY_CYCLE;
     }
 
-    if (P2PEnabled() || GetSettings()->Network.TxFrequency != 0) {
-        logDebug("Using frequency %d", GetSettings()->Network.TxFrequency);
+    if (P2PEnabled() || settings->Network.TxFrequency != 0) {
+        logDebug("Using frequency %d", settings->Network.TxFrequency);
 
-        if (GetSettings()->Test.DisableDutyCycle != lora::ON) {
-            int8_t band = GetDutyBand(GetSettings()->Network.TxFrequency);
-            logDebug("band: %d freq: %d", band, GetSettings()->Network.TxFrequency);
+        if (settings->Test.DisableDutyCycle != lora::ON) {
+            int8_t band = GetDutyBand(settings->Network.TxFrequency);
+            logDebug("band: %d freq: %d", band, settings->Network.TxFrequency);
             if (band != -1 && _dutyBands[band].TimeOffEnd != 0) {
                 return LORA_NO_CHANS_ENABLED;
             }
         }
 
-        GetRadio()->SetChannel(GetSettings()->Network.TxFrequency);
+        GetRadio()->SetChannel(settings->Network.TxFrequency);
         return LORA_OK;
     }
 
+    _adrEngine.Update();
+
     uint8_t start = 0;
     uint8_t maxChannels = _numChans125k;
     uint8_t nbEnabledChannels = 0;
-    uint8_t *enabledChannels = new uint8_t[maxChannels];
+    uint8_t enabledChannels[EU868_125K_NUM_CHANS];
 
     if (GetTxDatarate().Bandwidth == BW_500) {
         maxChannels = _numChans500k;
@@ -806,54 +855,34 @@ uint8_t ChannelPlan_EU868::GetNextChannel()
     }
 
 // Search how many channels are enabled
-    DatarateRange range;
-    uint8_t dr_index = GetSettings()->Session.TxDatarate;
+    uint8_t dr_index = settings->Session.TxDatarate;
     uint32_t now = _dutyCycleTimer.read_ms();
 
     for (size_t i = 0; i < _dutyBands.size(); i++) {
-        if (_dutyBands[i].TimeOffEnd < now || GetSettings()->Test.DisableDutyCycle == lora::ON) {
+        if (_dutyBands[i].TimeOffEnd < now || settings->Test.DisableDutyCycle == lora::ON) {
             _dutyBands[i].TimeOffEnd = 0;
         }
     }
 
-    for (uint8_t i = start; i < start + maxChannels; i++) {
-        range = GetChannel(i).DrRange;
-        // logDebug("chan: %d freq: %d range:%02x", i, GetChannel(i).Frequency, range.Value);
-
-        if (IsChannelEnabled(i) && (dr_index >= range.Fields.Min && dr_index <= range.Fields.Max)) {
-            int8_t band = GetDutyBand(GetChannel(i).Frequency);
-            // logDebug("band: %d freq: %d", band, _channels[i].Frequency);
-            if (band != -1 && _dutyBands[band].TimeOffEnd == 0) {
-                enabledChannels[nbEnabledChannels++] = i;
-            }
-        }
-    }
+    _channelTable.Sync(this);
+    nbEnabledChannels = _channelTable.Select(dr_index, GetChannelMaskView(), start, start + maxChannels, _dutyBands, enabledChannels);
 
     logTrace("Number of available channels: %d", nbEnabledChannels);
 
     uint32_t freq = 0;
-    int16_t thres = DEFAULT_FREE_CHAN_RSSI_THRESHOLD;
 
     if (nbEnabledChannels == 0) {
-        delete [] enabledChannels;
         return LORA_NO_CHANS_ENABLED;
     }
 
 
-    if (GetSettings()->Network.CADEnabled) {
-        // Search for free channel with ms timeout
-        int16_t timeout = 10000;
-        Timer tmr;
-        tmr.start();
-
-        for (uint8_t j = rand_r(0, nbEnabledChannels - 1); tmr.read_ms() < timeout; j++) {
-            freq = GetChannel(enabledChannels[j]).Frequency;
-
-            if (GetRadio()->IsChannelFree(SxRadio::MODEM_LORA, freq, thres)) {
-                _txChannel = enabledChannels[j];
-                break;
-            }
+    if (settings->Network.CADEnabled) {
+        // Listen before talk on least occupied channels, search continues in the background if all are busy
+        if (_channelSearch.Select(enabledChannels, nbEnabledChannels, _txChannel) != LORA_OK) {
+            return LORA_LBT_CHANNEL_BUSY;
         }
+
+        freq = GetChannel(_txChannel).Frequency;
     } else {
         uint8_t j = rand_r(0, nbEnabledChannels - 1);
         _txChannel = enabledChannels[j];
@@ -866,31 +895,36 @@ uint8_t ChannelPlan_EU868::GetNextChannel()
     GetRadio()->SetChannel(freq);
 
 
-    delete [] enabledChannels;
     return LORA_OK;
 }
 
 
 uint8_t lora::ChannelPlan_EU868::GetJoinDatarate() {
     uint8_t dr = GetSettings()->Session.TxDatarate;
-    static uint8_t cnt = 0;
+    uint8_t learned_dr = 0;
+    uint8_t sub_band = 0;
 
     if (GetSettings()->Test.DisableRandomJoinDatarate == lora::OFF) {
-        if ((cnt++ % 20) == 0) {
+        if (_joinHistory.GetLearned(_maxDatarate, 0, sub_band, learned_dr)) {
+            logDebug("JoinDatarate using learned datarate %d", learned_dr);
+            dr = learned_dr;
+        } else if ((_joinDatarateCnt++ % 20) == 0) {
             dr = lora::DR_0;
-        } else if ((cnt % 16) == 0) {
+        } else if ((_joinDatarateCnt % 16) == 0) {
             dr = lora::DR_1;
-        } else if ((cnt % 12) == 0) {
+        } else if ((_joinDatarateCnt % 12) == 0) {
             dr = lora::DR_2;
-        } else if ((cnt % 8) == 0) {
+        } else if ((_joinDatarateCnt % 8) == 0) {
             dr = lora::DR_3;
-        } else if ((cnt % 4) == 0) {
+        } else if ((_joinDatarateCnt % 4) == 0) {
             dr = lora::DR_4;
         } else {
             dr = lora::DR_5;
         }
     }
 
+    _joinHistory.Attempt(0, dr);
+
     return dr;
 }
 
@@ -898,10 +932,10 @@ uint8_t ChannelPlan_EU868::CalculateJoinBackoff(uint8_t size) {
 
     time_t now = time(NULL);
     uint32_t time_on_max = 0;
-    static uint32_t time_off_max = 15;
+    uint32_t& time_off_max = _joinHistory.Get().TimeOffMax;
     uint32_t rand_time_off = 0;
 
-    // TODO: calc time-off-max based on RTC time from JoinFirstAttempt, time-off-max is lost over sleep
+    _joinHistory.Restore(GetSettings());
 
     if ((time_t)GetSettings()->Session.JoinTimeOffEnd > now) {
         return LORA_JOIN_BACKOFF;
@@ -910,7 +944,7 @@ uint8_t ChannelPlan_EU868::CalculateJoinBackoff(uint8_t size) {
     uint32_t secs_since_first_attempt = (now - GetSettings()->Session.JoinFirstAttempt);
     uint16_t hours_since_first_attempt = secs_since_first_attempt / (60 * 60);
 
-    static uint8_t join_cnt = 0;
+    uint16_t& join_cnt = _joinHistory.Get().JoinCount;
 
     join_cnt = (join_cnt+1) % 8;
 
@@ -981,40 +1015,11 @@ uint8_t ChannelPlan_EU868::CalculateJoinBackoff(uint8_t size) {
         GetSettings()->Session.JoinTimeOffEnd = now + (GetTimeOnAir(size) / 10);
     }
 
+    _joinHistory.Backoff(GetSettings());
+
     return LORA_OK;
 }
 
 uint8_t ChannelPlan_EU868::DecodeBeacon(const uint8_t* payload, size_t size, BeaconData_t& data) {
-    uint16_t crc1, crc1_rx, crc2, crc2_rx;
-    const BCNPayload* beacon = (const BCNPayload*)payload;
-
-    // First check the size of the packet
-    if (size != sizeof(BCNPayload))
-        return LORA_BEACON_SIZE;
-
-    // Next we verify CRC1 is correct
-    crc1 = CRC16(beacon->RFU, sizeof(beacon->RFU) + sizeof(beacon->Time));
-    memcpy((uint8_t*)&crc1_rx, beacon->CRC1, sizeof(uint16_t));
-
-    if (crc1 != crc1_rx)
-        return LORA_BEACON_CRC;
-
-    // Now that we have confirmed this packet is a beacon, parse and complete the output struct
-    memcpy(&data.Time, beacon->Time, sizeof(beacon->Time));
-    data.InfoDesc = beacon->GwSpecific[0];
-
-    crc2 = CRC16(beacon->GwSpecific, sizeof(beacon->GwSpecific));
-    memcpy((uint8_t*)&crc2_rx, beacon->CRC2, sizeof(uint16_t));
-
-    // Update the GPS fields if we have a gps info descriptor and valid crc
-    if (crc2 == crc2_rx &&
-        (data.InfoDesc == GPS_FIRST_ANTENNA ||
-         data.InfoDesc == GPS_SECOND_ANTENNA ||
-         data.InfoDesc == GPS_THIRD_ANTENNA)) {
-        // Latitude and Longitude 3 bytes in length
-        memcpy(&data.Latitude, &beacon->GwSpecific[1], 3);
-        memcpy(&data.Longitude, &beacon->GwSpecific[4], 3);
-    }
-
-    return LORA_OK;
+    return DecodeBeaconPayload(payload, size, _beaconSize, offsetof(BCNPayload, Time), data);
 }
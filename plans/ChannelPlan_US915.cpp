@@ -16,6 +16,8 @@
 ***********************************************************************/
 
 #include "ChannelPlan_US915.h"
+#include "BeaconPayload.h"
+#include "DotStats.h"
 #include "limits.h"
 
 using namespace lora;
@@ -27,21 +29,36 @@ const uint8_t ChannelPlan_US915::US915_MAX_PAYLOAD_SIZE_REPEATER[] = { 11, 53, 1
 
 ChannelPlan_US915::ChannelPlan_US915()
 :
-  ChannelPlan(NULL, NULL)
+  ChannelPlan(NULL, NULL),
+  _channelSearch(this),
+  _adrEngine(this),
+  _joinFsb(1),
+  _joinDr4Fsb(1),
+  _joinAltDr(false)
 {
     _beaconSize = sizeof(BCNPayload);
 }
 
 ChannelPlan_US915::ChannelPlan_US915(Settings* settings)
 :
-  ChannelPlan(NULL, settings)
+  ChannelPlan(NULL, settings),
+  _channelSearch(this),
+  _adrEngine(this),
+  _joinFsb(1),
+  _joinDr4Fsb(1),
+  _joinAltDr(false)
 {
     _beaconSize = sizeof(BCNPayload);
 }
 
 ChannelPlan_US915::ChannelPlan_US915(SxRadio* radio, Settings* settings)
 :
-  ChannelPlan(radio, settings)
+  ChannelPlan(radio, settings),
+  _channelSearch(this),
+  _adrEngine(this),
+  _joinFsb(1),
+  _joinDr4Fsb(1),
+  _joinAltDr(false)
 {
     _beaconSize = sizeof(BCNPayload);
 }
@@ -50,6 +67,23 @@ ChannelPlan_US915::~ChannelPlan_US915() {
 
 }
 
+void ChannelPlan_US915::SetEventQueue(EventQueue* queue) {
+    ChannelPlan::SetEventQueue(queue);
+    _channelSearch.SetEventQueue(queue);
+}
+
+ChannelSearch& ChannelPlan_US915::GetChannelSearch() {
+    return _channelSearch;
+}
+
+AdrEngine& ChannelPlan_US915::GetAdrEngine() {
+    return _adrEngine;
+}
+
+JoinHistory& ChannelPlan_US915::GetJoinHistory() {
+    return _joinHistory;
+}
+
 void ChannelPlan_US915::Init() {
     _plan = US915;
     _planName = "US915";
@@ -58,6 +92,10 @@ void ChannelPlan_US915::Init() {
     _channels.clear();
     _dutyBands.clear();
 
+#if defined(CHANNEL_PLAN_STATIC_MEMORY)
+    ReserveStorage(US915_125K_NUM_CHANS + US915_500K_NUM_CHANS, 0);
+#endif
+
     DutyBand band;
 
     band.Index = 0;
@@ -155,6 +193,7 @@ void ChannelPlan_US915::Init() {
 
     SetFrequencySubBand(GetSettings()->Network.FrequencySubBand);
 
+    _channelTable.Invalidate();
 }
 
 uint8_t ChannelPlan_US915::HandleJoinAccept(const uint8_t* buffer, uint8_t size) {
@@ -165,6 +204,8 @@ uint8_t ChannelPlan_US915::HandleJoinAccept(const uint8_t* buffer, uint8_t size)
         }
     }
 
+    _joinHistory.Joined();
+
     return LORA_OK;
 }
 
@@ -177,6 +218,7 @@ void ChannelPlan_US915::SetNumberOfChannels(uint8_t channels, bool resize) {
 
     _channelMask.resize(newsize, 0x0);
     _numChans = channels;
+    _channelTable.Invalidate();
 
 }
 
@@ -224,15 +266,16 @@ uint8_t ChannelPlan_US915::SetRx2DatarateIndex(uint8_t index) {
 }
 
 uint8_t ChannelPlan_US915::SetTxConfig() {
+    Settings* settings = GetSettings();
 
     uint8_t band = GetDutyBand(GetChannel(_txChannel).Frequency);
-    Datarate txDr = GetDatarate(GetSettings()->Session.TxDatarate);
+    Datarate txDr = GetDatarate(settings->Session.TxDatarate);
     int8_t max_pwr = _dutyBands[band].PowerMax;
     uint8_t chans_enabled = 0;
 
     int8_t pwr = 0;
 
-    pwr = std::min < int8_t > (GetSettings()->Session.TxPower, max_pwr);
+    pwr = std::min < int8_t > (settings->Session.TxPower, max_pwr);
 
     // spec states that if < 50 125kHz channels are enabled, power is limited to 21dB conducted
     chans_enabled += CountBits(_channelMask[0]);
@@ -243,8 +286,8 @@ uint8_t ChannelPlan_US915::SetTxConfig() {
         pwr = 21;
     }
 
-    if (pwr + GetSettings()->Network.AntennaGain >= max_pwr + 6 && GetSettings()->Network.AntennaGain > 6) {
-        pwr -= (GetSettings()->Network.AntennaGain - 6);
+    if (pwr + settings->Network.AntennaGain >= max_pwr + 6 && settings->Network.AntennaGain > 6) {
+        pwr -= (settings->Network.AntennaGain - 6);
     }
 
     for (int i = 20; i >= 0; i--) {
@@ -257,8 +300,8 @@ uint8_t ChannelPlan_US915::SetTxConfig() {
         }
     }
 
-    logDebug("Session pwr: %d ant: %d max: %d", GetSettings()->Session.TxPower, GetSettings()->Network.AntennaGain, max_pwr);
-    logDebug("Radio Power index: %d output: %d total: %d", pwr, RADIO_POWERS[pwr], RADIO_POWERS[pwr] + GetSettings()->Network.AntennaGain);
+    logDebug("Session pwr: %d ant: %d max: %d", settings->Session.TxPower, settings->Network.AntennaGain, max_pwr);
+    logDebug("Radio Power index: %d output: %d total: %d", pwr, RADIO_POWERS[pwr], RADIO_POWERS[pwr] + settings->Network.AntennaGain);
 
     uint32_t bw = txDr.Bandwidth;
     uint32_t sf = txDr.SpreadingFactor;
@@ -268,7 +311,7 @@ uint8_t ChannelPlan_US915::SetTxConfig() {
     bool crc = txDr.Crc;
     bool iq = txDr.TxIQ;
 
-    if (GetSettings()->Network.DisableCRC == true)
+    if (settings->Network.DisableCRC == true)
         crc = false;
 
     SxRadio::RadioModems_t modem = SxRadio::MODEM_LORA;
@@ -299,6 +342,8 @@ uint8_t ChannelPlan_US915::AddChannel(int8_t index, Channel channel) {
         _channels.push_back(channel);
     }
 
+    _channelTable.Invalidate();
+
     return LORA_OK;
 }
 
@@ -598,13 +643,20 @@ uint8_t ChannelPlan_US915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
 
     uint16_t t_125k = 0; //used only in ctrl case 5
 
+    // Stage the new mask, only words that change are written back
+    uint16_t masks[5];
+
+    for (uint8_t i = 0; i < 5; i++) {
+        masks[i] = i < _channelMask.size() ? _channelMask[i] : 0;
+    }
+
     switch (ctrl) {
         case 0:
         case 1:
         case 2:
         case 3:
         case 4:
-            SetChannelMask(ctrl, mask);
+            masks[ctrl] = mask;
             break;
 
         case 5:
@@ -614,11 +666,11 @@ uint8_t ChannelPlan_US915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
                         t_125k |= (0xff << ((i % 2) * 8)); // this does either 0xff00 or 0x00ff to t_125k
                     }
                     if(i % 2 == 1) { // if 1 then both halfs of the mask were set
-                        SetChannelMask(i/2, t_125k);
+                        masks[i/2] = t_125k;
                         t_125k = 0; //reset mask for next two bits
                     }
                 }
-                SetChannelMask(4, mask);
+                masks[4] = mask;
             } else {
                 status &= 0xFE; // ChannelMask KO
                 logWarning("Rejecting mask, will not disable all channels");
@@ -628,20 +680,20 @@ uint8_t ChannelPlan_US915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
 
         case 6:
             // enable all 125 kHz channels
-            SetChannelMask(0, 0xFFFF);
-            SetChannelMask(1, 0xFFFF);
-            SetChannelMask(2, 0xFFFF);
-            SetChannelMask(3, 0xFFFF);
-            SetChannelMask(4, mask);
+            masks[0] = 0xFFFF;
+            masks[1] = 0xFFFF;
+            masks[2] = 0xFFFF;
+            masks[3] = 0xFFFF;
+            masks[4] = mask;
             break;
 
         case 7:
             // disable all 125 kHz channels
-            SetChannelMask(0, 0x0);
-            SetChannelMask(1, 0x0);
-            SetChannelMask(2, 0x0);
-            SetChannelMask(3, 0x0);
-            SetChannelMask(4, mask);
+            masks[0] = 0x0;
+            masks[1] = 0x0;
+            masks[2] = 0x0;
+            masks[3] = 0x0;
+            masks[4] = mask;
             break;
 
         default:
@@ -650,8 +702,15 @@ uint8_t ChannelPlan_US915::HandleAdrCommand(const uint8_t* payload, uint8_t inde
             return LORA_ERROR;
     }
 
+    for (uint8_t i = 0; i < 5; i++) {
+        if (i >= _channelMask.size() || masks[i] != _channelMask[i])
+            SetChannelMask(i, masks[i]);
+    }
+
     if (GetSettings()->Network.ADREnabled) {
         if (status == 0x07) {
+            if (datarate != 0xF || power != 0xF)
+                _adrEngine.NetworkAdr();
             if (datarate != 0xF)
                 GetSettings()->Session.TxDatarate = datarate;
             if (power != 0xF)
@@ -705,21 +764,23 @@ uint8_t ChannelPlan_US915::ValidateAdrConfiguration() {
 
 uint32_t ChannelPlan_US915::GetTimeOffAir()
 {
-    if (GetSettings()->Test.DisableDutyCycle == lora::ON)
+    Settings* settings = GetSettings();
+
+    if (settings->Test.DisableDutyCycle == lora::ON)
         return 0;
 
     uint32_t min = 0;
     uint32_t now = _dutyCycleTimer.read_ms();
 
-    if (GetSettings()->Session.AggregatedTimeOffEnd > 0 && GetSettings()->Session.AggregatedTimeOffEnd > now) {
-        min = std::max < uint32_t > (min, GetSettings()->Session.AggregatedTimeOffEnd - now);
+    if (settings->Session.AggregatedTimeOffEnd > 0 && settings->Session.AggregatedTimeOffEnd > now) {
+        min = std::max < uint32_t > (min, settings->Session.AggregatedTimeOffEnd - now);
     }
 
     now = time(NULL);
     uint32_t join_time = 0;
 
-    if (GetSettings()->Session.JoinFirstAttempt != 0 && now < GetSettings()->Session.JoinTimeOffEnd) {
-        join_time = (GetSettings()->Session.JoinTimeOffEnd - now) * 1000;
+    if (settings->Session.JoinFirstAttempt != 0 && now < settings->Session.JoinTimeOffEnd) {
+        join_time = (settings->Session.JoinTimeOffEnd - now) * 1000;
     }
 
     min = std::max < uint32_t > (join_time, min);
@@ -778,29 +839,35 @@ void lora::ChannelPlan_US915::EnableDefaultChannels() {
 
 uint8_t ChannelPlan_US915::GetNextChannel()
 {
-    if (GetSettings()->Session.AggregatedTimeOffEnd != 0) {
+    DOT_STATS_TIME(SUBSYSTEM_PLAN);
+
+    Settings* settings = GetSettings();
+
+    if (settings->Session.AggregatedTimeOffEnd != 0) {
         return LORA_AGGREGATED_DUTY_CYCLE;
     }
 
-    if (P2PEnabled() || GetSettings()->Network.TxFrequency != 0) {
-        logDebug("Using frequency %d", GetSettings()->Network.TxFrequency);
+    if (P2PEnabled() || settings->Network.TxFrequency != 0) {
+        logDebug("Using frequency %d", settings->Network.TxFrequency);
 
-        if (GetSettings()->Test.DisableDutyCycle != lora::ON) {
-            int8_t band = GetDutyBand(GetSettings()->Network.TxFrequency);
-            logDebug("band: %d freq: %d", band, GetSettings()->Network.TxFrequency);
+        if (settings->Test.DisableDutyCycle != lora::ON) {
+            int8_t band = GetDutyBand(settings->Network.TxFrequency);
+            logDebug("band: %d freq: %d", band, settings->Network.TxFrequency);
             if (band != -1 && _dutyBands[band].TimeOffEnd != 0) {
                 return LORA_NO_CHANS_ENABLED;
             }
         }
 
-        GetRadio()->SetChannel(GetSettings()->Network.TxFrequency);
+        GetRadio()->SetChannel(settings->Network.TxFrequency);
         return LORA_OK;
     }
 
+    _adrEngine.Update();
+
     uint8_t start = 0;
     uint8_t maxChannels = _numChans125k;
     uint8_t nbEnabledChannels = 0;
-    uint8_t *enabledChannels = new uint8_t[maxChannels];
+    uint8_t enabledChannels[US915_125K_NUM_CHANS];
 
     if (GetTxDatarate().Bandwidth == BW_500) {
         maxChannels = _numChans500k;
@@ -808,28 +875,17 @@ uint8_t ChannelPlan_US915::GetNextChannel()
     }
 
 // Search how many channels are enabled
-    DatarateRange range;
-    uint8_t dr_index = GetSettings()->Session.TxDatarate;
+    uint8_t dr_index = settings->Session.TxDatarate;
     uint32_t now = _dutyCycleTimer.read_ms();
 
     for (size_t i = 0; i < _dutyBands.size(); i++) {
-        if (_dutyBands[i].TimeOffEnd < now || GetSettings()->Test.DisableDutyCycle == lora::ON) {
+        if (_dutyBands[i].TimeOffEnd < now || settings->Test.DisableDutyCycle == lora::ON) {
             _dutyBands[i].TimeOffEnd = 0;
         }
     }
 
-    for (uint8_t i = start; i < start + maxChannels; i++) {
-        range = GetChannel(i).DrRange;
-        // logDebug("chan: %d freq: %d range:%02x", i, GetChannel(i).Frequency, range.Value);
-
-        if (IsChannelEnabled(i) && (dr_index >= range.Fields.Min && dr_index <= range.Fields.Max)) {
-            int8_t band = GetDutyBand(GetChannel(i).Frequency);
-            // logDebug("band: %d freq: %d", band, _channels[i].Frequency);
-            if (band != -1 && _dutyBands[band].TimeOffEnd == 0) {
-                enabledChannels[nbEnabledChannels++] = i;
-            }
-        }
-    }
+    _channelTable.Sync(this);
+    nbEnabledChannels = _channelTable.Select(dr_index, GetChannelMaskView(), start, start + maxChannels, _dutyBands, enabledChannels);
 
     if (GetTxDatarate().Bandwidth == BW_500) {
         _dutyBands[0].PowerMax = 26;
@@ -843,27 +899,18 @@ uint8_t ChannelPlan_US915::GetNextChannel()
     logTrace("Number of available channels: %d", nbEnabledChannels);
 
     uint32_t freq = 0;
-    int16_t thres = DEFAULT_FREE_CHAN_RSSI_THRESHOLD;
 
     if (nbEnabledChannels == 0) {
-        delete [] enabledChannels;
         return LORA_NO_CHANS_ENABLED;
     }
 
-    if (GetSettings()->Network.CADEnabled) {
-        // Search for free channel with ms timeout
-        int16_t timeout = 10000;
-        Timer tmr;
-        tmr.start();
-
-        for (uint8_t j = rand_r(0, nbEnabledChannels - 1); tmr.read_ms() < timeout; j++) {
-            freq = GetChannel(enabledChannels[j]).Frequency;
-
-            if (GetRadio()->IsChannelFree(SxRadio::MODEM_LORA, freq, thres)) {
-                _txChannel = enabledChannels[j];
-                break;
-            }
+    if (settings->Network.CADEnabled) {
+        // Listen before talk on least occupied channels, search continues in the background if all are busy
+        if (_channelSearch.Select(enabledChannels, nbEnabledChannels, _txChannel) != LORA_OK) {
+            return LORA_LBT_CHANNEL_BUSY;
         }
+
+        freq = GetChannel(_txChannel).Frequency;
     } else {
         uint8_t j = rand_r(0, nbEnabledChannels - 1);
         _txChannel = enabledChannels[j];
@@ -875,40 +922,47 @@ uint8_t ChannelPlan_US915::GetNextChannel()
     logDebug("Using channel %d : %d", _txChannel, freq);
     GetRadio()->SetChannel(freq);
 
-    delete [] enabledChannels;
     return LORA_OK;
 }
 
 uint8_t lora::ChannelPlan_US915::GetJoinDatarate() {
     uint8_t dr = GetSettings()->Session.TxDatarate;
-    static uint8_t fsb = 1;
-    static uint8_t dr4_fsb = 1;
-    static bool altdr = false;
+    uint8_t learned_dr = 0;
+    uint8_t sub_band = 0;
 
     if (GetSettings()->Test.DisableRandomJoinDatarate == lora::OFF) {
 
-        if (GetSettings()->Network.FrequencySubBand == 0) {
-
-            if (fsb < 9) {
-                SetFrequencySubBand(fsb);
-                logDebug("JoinDatarate setting frequency sub band to %d",fsb);
-                fsb++;
+        if (_joinHistory.GetLearned(_maxDatarate, GetSettings()->Network.FrequencySubBand, sub_band, learned_dr)) {
+            if (sub_band != 0) {
+                SetFrequencySubBand(sub_band);
+            }
+            logDebug("JoinDatarate using learned sub band %d datarate %d", sub_band, learned_dr);
+            dr = learned_dr;
+        } else if (GetSettings()->Network.FrequencySubBand == 0) {
+
+            if (_joinFsb < 9) {
+                SetFrequencySubBand(_joinFsb);
+                logDebug("JoinDatarate setting frequency sub band to %d",_joinFsb);
+                _joinFsb++;
                 dr = lora::DR_0;
             } else {
                 dr = lora::DR_4;
-                fsb = 1;
-                dr4_fsb++;
-                if(dr4_fsb > 8)
-                    dr4_fsb = 1;
-                SetFrequencySubBand(dr4_fsb);
+                _joinFsb = 1;
+                _joinDr4Fsb++;
+                if(_joinDr4Fsb > 8)
+                    _joinDr4Fsb = 1;
+                SetFrequencySubBand(_joinDr4Fsb);
             }
-        } else if (altdr && CountBits(_channelMask[4] > 0)) {
+        } else if (_joinAltDr && CountBits(_channelMask[4] > 0)) {
             dr = lora::DR_4;
         } else {
             dr = lora::DR_0;
         }
-        altdr = !altdr;
+        _joinAltDr = !_joinAltDr;
     }
+
+    _joinHistory.Attempt(_txFrequencySubBand, dr);
+
     return dr;
 }
 
@@ -916,11 +970,11 @@ uint8_t lora::ChannelPlan_US915::CalculateJoinBackoff(uint8_t size) {
 
     time_t now = time(NULL);
     uint32_t time_on_max = 0;
-    static uint32_t time_off_max = 15;
+    uint32_t& time_off_max = _joinHistory.Get().TimeOffMax;
     uint32_t rand_time_off = 0;
-    static uint16_t join_cnt = 0;
+    uint16_t& join_cnt = _joinHistory.Get().JoinCount;
 
-    // TODO: calc time-off-max based on RTC time from JoinFirstAttempt, time-off-max is lost over sleep
+    _joinHistory.Restore(GetSettings());
 
     if ((time_t)GetSettings()->Session.JoinTimeOffEnd > now) {
         return LORA_JOIN_BACKOFF;
@@ -998,42 +1052,13 @@ uint8_t lora::ChannelPlan_US915::CalculateJoinBackoff(uint8_t size) {
         GetSettings()->Session.JoinTimeOffEnd = now + rand_r(GetSettings()->Network.JoinDelay + 2, GetSettings()->Network.JoinDelay + 3);
     }
 
+    _joinHistory.Backoff(GetSettings());
+
     return LORA_OK;
 }
 
 uint8_t ChannelPlan_US915::DecodeBeacon(const uint8_t* payload, size_t size, BeaconData_t& data) {
-    uint16_t crc1, crc1_rx, crc2, crc2_rx;
-    const BCNPayload* beacon = (const BCNPayload*)payload;
-
-    // First check the size of the packet
-    if (size != sizeof(BCNPayload))
-        return LORA_BEACON_SIZE;
-
-    // Next we verify CRC1 is correct
-    crc1 = CRC16(beacon->RFU1, sizeof(beacon->RFU1) + sizeof(beacon->Time));
-    memcpy((uint8_t*)&crc1_rx, beacon->CRC1, sizeof(uint16_t));
-
-    if (crc1 != crc1_rx)
-        return LORA_BEACON_CRC;
-
-    // Now that we have confirmed this packet is a beacon, parse and complete the output struct
-    memcpy(&data.Time, beacon->Time, sizeof(beacon->Time));
-    data.InfoDesc = beacon->GwSpecific[0];
-
-    crc2 = CRC16(beacon->GwSpecific, sizeof(beacon->GwSpecific) + sizeof(beacon->RFU2));
-    memcpy((uint8_t*)&crc2_rx, beacon->CRC2, sizeof(uint16_t));
-
-    // Update the GPS fields if we have a gps info descriptor and valid crc
-    if (crc2 == crc2_rx &&
-        (data.InfoDesc == GPS_FIRST_ANTENNA ||
-         data.InfoDesc == GPS_SECOND_ANTENNA ||
-         data.InfoDesc == GPS_THIRD_ANTENNA)) {
-        // Latitude and Longitude 3 bytes in length
-        memcpy(&data.Latitude, &beacon->GwSpecific[1], 3);
-        memcpy(&data.Longitude, &beacon->GwSpecific[4], 3);
-    }
-
-    return LORA_OK;
+    return DecodeBeaconPayload(payload, size, _beaconSize, offsetof(BCNPayload, Time), data);
 }
 
 void ChannelPlan_US915::FrequencyHop(uint32_t time, uint32_t period, uint32_t devAddr) {
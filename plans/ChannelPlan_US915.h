@@ -19,6 +19,10 @@
 #include "Lora.h"
 #include "SxRadio.h"
 #include "ChannelPlan.h"
+#include "ChannelSearch.h"
+#include "ChannelTable.h"
+#include "AdrEngine.h"
+#include "JoinHistory.h"
 #include <vector>
 
 namespace lora {
@@ -78,6 +82,26 @@ namespace lora {
              */
             virtual uint8_t GetNextChannel();
 
+            /**
+             * Set the event queue used by the plan and the background LBT channel search
+             */
+            virtual void SetEventQueue(EventQueue* queue);
+
+            /**
+             * Get the listen before talk channel search
+             */
+            ChannelSearch& GetChannelSearch();
+
+            /**
+             * Get the device side ADR engine
+             */
+            AdrEngine& GetAdrEngine();
+
+            /**
+             * Get the join history used to start joins with the last successful configuration
+             */
+            JoinHistory& GetJoinHistory();
+
             /**
              * Set the number of channels in the plan
              */
@@ -286,6 +310,14 @@ namespace lora {
 
         protected:
 
+            ChannelSearch _channelSearch;                               //!< Non-blocking listen before talk channel search
+            ChannelTable<US915_125K_NUM_CHANS + US915_500K_NUM_CHANS> _channelTable; //!< Channel bitmaps per datarate for channel selection
+            AdrEngine _adrEngine;                                       //!< Device side adaptive datarate
+            JoinHistory _joinHistory;                                   //!< Join backoff state and last successful join configuration
+            uint8_t _joinFsb;                                           //!< Next sub band to join on when sub band is 0
+            uint8_t _joinDr4Fsb;                                        //!< Next sub band to join on with DR4
+            bool _joinAltDr;                                            //!< Alternate DR0 and DR4 join requests
+
             static const uint8_t US915_TX_POWERS[11];                   //!< List of available tx powers
             static const uint8_t US915_RADIO_POWERS[21];                //!< List of calibrated tx powers
             static const uint8_t US915_MAX_PAYLOAD_SIZE[];              //!< List of max payload sizes for each datarate
@@ -0,0 +1,276 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "ChannelSearch.h"
+#include "ChannelPlan.h"
+
+using namespace lora;
+
+ChannelSearch::ChannelSearch(ChannelPlan* plan)
+:
+  _plan(plan),
+  _queue(NULL),
+  _state(SEARCH_IDLE),
+  _count(0),
+  _next(0),
+  _freeChannel(0),
+  _timeout(LBT_SEARCH_TIMEOUT),
+  _evtId(0)
+{
+    ResetStats();
+}
+
+ChannelSearch::~ChannelSearch() {
+    Cancel();
+}
+
+void ChannelSearch::SetEventQueue(EventQueue* queue) {
+    Cancel();
+    _queue = queue;
+}
+
+void ChannelSearch::SetCallback(Callback<void(uint8_t, uint8_t)> cb) {
+    _callback = cb;
+}
+
+ChannelSearch::State ChannelSearch::GetState() {
+    return _state;
+}
+
+const ChannelSearch::LbtStats& ChannelSearch::GetStats() {
+    return _stats;
+}
+
+void ChannelSearch::ResetStats() {
+    memset(&_stats, 0, sizeof(_stats));
+    memset(_occupancy, 0, sizeof(_occupancy));
+}
+
+uint8_t ChannelSearch::GetOccupancy(uint8_t channel) {
+    if (channel >= LBT_MAX_CHANNELS)
+        return 0;
+
+    return _occupancy[channel];
+}
+
+uint8_t ChannelSearch::Select(const uint8_t* channels, uint8_t count, uint8_t& channel) {
+    if (count == 0)
+        return LORA_NO_CHANS_ENABLED;
+
+    if (_state == SEARCH_FREE) {
+        _state = SEARCH_IDLE;
+
+        // Channel found in the background is used if it is still a candidate and the result is fresh
+        if (_freeTimer.read_ms() < LBT_RESULT_VALID) {
+            for (uint8_t i = 0; i < count; i++) {
+                if (channels[i] == _freeChannel) {
+                    channel = _freeChannel;
+                    return LORA_OK;
+                }
+            }
+        }
+    }
+
+    if (_state != SEARCH_IDLE) {
+        logTrace("LBT search in progress");
+        return LORA_LBT_CHANNEL_BUSY;
+    }
+
+    Prioritize(channels, count);
+
+    uint8_t probes = count < LBT_FAST_PROBES ? count : LBT_FAST_PROBES;
+    int16_t rssi = 0;
+
+    for (uint8_t i = 0; i < probes; i++) {
+        bool busy = Probe(_candidates[i], rssi);
+
+        Record(_candidates[i], busy, rssi);
+
+        if (!busy) {
+            channel = _candidates[i];
+            return LORA_OK;
+        }
+    }
+
+    logDebug("LBT %d channels busy, searching in background", probes);
+    Start(channels, count);
+
+    return LORA_LBT_CHANNEL_BUSY;
+}
+
+uint8_t ChannelSearch::Start(const uint8_t* channels, uint8_t count, uint32_t timeout) {
+    if (_queue == NULL || count == 0)
+        return LORA_ERROR;
+
+    Cancel();
+    Prioritize(channels, count);
+
+    _timeout = timeout;
+    _stats.Searches++;
+    _searchTimer.reset();
+    _searchTimer.start();
+
+    Schedule(0);
+    return LORA_OK;
+}
+
+void ChannelSearch::Cancel() {
+    if (_queue != NULL && _evtId != 0) {
+        _queue->cancel(_evtId);
+    }
+
+    _evtId = 0;
+    _state = SEARCH_IDLE;
+}
+
+void ChannelSearch::Prioritize(const uint8_t* channels, uint8_t count) {
+    if (count > LBT_MAX_CHANNELS)
+        count = LBT_MAX_CHANNELS;
+
+    // Random rotation spreads traffic across channels of equal occupancy
+    uint8_t offset = rand_r(0, count - 1);
+
+    for (uint8_t i = 0; i < count; i++) {
+        _candidates[i] = channels[(i + offset) % count];
+    }
+
+    // Stable insertion sort on coarse occupancy, least occupied first
+    for (uint8_t i = 1; i < count; i++) {
+        uint8_t chan = _candidates[i];
+        uint8_t occ = GetOccupancy(chan) >> 4;
+        uint8_t j = i;
+
+        while (j > 0 && (GetOccupancy(_candidates[j - 1]) >> 4) > occ) {
+            _candidates[j] = _candidates[j - 1];
+            j--;
+        }
+
+        _candidates[j] = chan;
+    }
+
+    _count = count;
+    _next = 0;
+}
+
+void ChannelSearch::Schedule(int delay_ms) {
+    _state = delay_ms > 0 ? SEARCH_BACKOFF : SEARCH_PROBE;
+
+    if (delay_ms > 0) {
+        _evtId = _queue->call_in(delay_ms, this, &ChannelSearch::Step);
+    } else {
+        _evtId = _queue->call(this, &ChannelSearch::Step);
+    }
+
+    if (_evtId == 0) {
+        logError("LBT failed to queue search");
+        Finish(LORA_LBT_CHANNEL_BUSY);
+    }
+}
+
+void ChannelSearch::Step() {
+    _evtId = 0;
+
+    if (_state != SEARCH_PROBE && _state != SEARCH_BACKOFF)
+        return;
+
+    if ((uint32_t)_searchTimer.read_ms() >= _timeout) {
+        logWarning("LBT no free channel found in %lu ms", _timeout);
+        _stats.Timeouts++;
+        Finish(LORA_LBT_CHANNEL_BUSY);
+        return;
+    }
+
+    // The MAC owns the radio while it is receiving or transmitting, retuning it would break
+    // the running operation so the round is retried later
+    if (_plan->GetRadio()->Status() != SxRadio::RF_IDLE) {
+        _stats.RadioBusy++;
+        Schedule(rand_r(LBT_BACKOFF_MIN, LBT_BACKOFF_MAX));
+        return;
+    }
+
+    int16_t rssi = 0;
+    bool busy = Probe(_candidates[_next], rssi);
+    ProbeDone(busy, rssi);
+}
+
+bool ChannelSearch::Probe(uint8_t channel, int16_t& rssi) {
+    uint32_t freq = _plan->GetChannel(channel).Frequency;
+
+    // Sense for the LBT sample time of the plan, not the radio default of seconds
+    uint32_t sense_ms = (_plan->GetLBT_TimeUs() + 999U) / 1000U;
+
+    if (sense_ms < LBT_SENSE_MIN)
+        sense_ms = LBT_SENSE_MIN;
+
+    return !_plan->GetRadio()->IsChannelFree(SxRadio::MODEM_LORA, freq, DEFAULT_FREE_CHAN_RSSI_THRESHOLD, sense_ms, &rssi);
+}
+
+void ChannelSearch::ProbeDone(bool busy, int16_t rssi) {
+    uint8_t channel = _candidates[_next];
+
+    Record(channel, busy, rssi);
+
+    if (!busy) {
+        _freeChannel = channel;
+        _freeTimer.reset();
+        _freeTimer.start();
+        _stats.Found++;
+        Finish(LORA_OK);
+        return;
+    }
+
+    // Yield to other events between probes, back off after each full round
+    if (++_next >= _count) {
+        _next = 0;
+        Schedule(rand_r(LBT_BACKOFF_MIN, LBT_BACKOFF_MAX));
+    } else {
+        Schedule(0);
+    }
+}
+
+void ChannelSearch::Finish(uint8_t status) {
+    _searchTimer.stop();
+    _stats.LastSearchMs = _searchTimer.read_ms();
+    _state = (status == LORA_OK) ? SEARCH_FREE : SEARCH_IDLE;
+
+    logDebug("LBT search done status: %d channel: %d time: %lu ms", status, _freeChannel, _stats.LastSearchMs);
+
+    // Posted so the application can send from the callback once the search event has returned
+    if (_callback && _queue != NULL) {
+        _queue->call(_callback, status, _freeChannel);
+    }
+}
+
+void ChannelSearch::Record(uint8_t channel, bool busy, int16_t rssi) {
+    _stats.Probes++;
+    _stats.LastRssi = rssi;
+
+    if (busy)
+        _stats.Busy++;
+
+    if (channel >= LBT_MAX_CHANNELS)
+        return;
+
+    // Exponential moving average with weight 1/8
+    if (busy) {
+        _occupancy[channel] += (255 - _occupancy[channel]) >> 3;
+    } else {
+        _occupancy[channel] -= _occupancy[channel] >> 3;
+    }
+
+    logTrace("LBT chan: %d busy: %d rssi: %d occupancy: %d", channel, busy, rssi, _occupancy[channel]);
+}
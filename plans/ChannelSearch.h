@@ -0,0 +1,172 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::ChannelSearch provides a non-blocking listen before talk channel search
+ *
+ * @details
+ *  Candidate channels are probed in priority order, least occupied first.
+ *  A short synchronous pass is made when the MAC asks for a channel, if every
+ *  candidate is busy the search continues as a state machine on the channel
+ *  plan event queue. The channel found is used by the next Select call and
+ *  the completion callback is posted to the queue. The application should retry
+ *  its send from that callback, the channel is only used without probing again
+ *  for LBT_RESULT_VALID ms.
+ *
+ *  Probes use SxRadio::IsChannelFree for the LBT sample time of the plan, so an
+ *  event holds the queue for a few ms at most. Background probes are only made
+ *  while the radio is idle, a round is skipped while the MAC is using it.
+ */
+
+#ifndef __CHANNEL_SEARCH_H__
+#define __CHANNEL_SEARCH_H__
+
+#include "mbed_events.h"
+
+#include "Lora.h"
+#include "SxRadio.h"
+
+namespace lora {
+
+    class ChannelPlan;
+
+    const uint8_t LBT_MAX_CHANNELS = 72;            //!< Max number of channels tracked for occupancy
+    const uint8_t LBT_FAST_PROBES = 4;              //!< Max channels probed synchronously before searching in the background
+    const uint32_t LBT_SEARCH_TIMEOUT = 10000U;     //!< Time in ms to search in the background before giving up
+    const uint32_t LBT_SENSE_MIN = 1U;              //!< Min time in ms passed to SxRadio::IsChannelFree
+    const uint16_t LBT_BACKOFF_MIN = 20U;           //!< Min time in ms between search rounds
+    const uint16_t LBT_BACKOFF_MAX = 100U;          //!< Max time in ms between search rounds
+    const uint16_t LBT_RESULT_VALID = 50U;          //!< Time in ms a channel found in the background is used without probing again
+
+    class ChannelSearch {
+        public:
+
+            /**
+             * State of the background search
+             */
+            enum State {
+                SEARCH_IDLE,        //!< No search in progress
+                SEARCH_PROBE,       //!< Probe of next candidate is queued
+                SEARCH_BACKOFF,     //!< All candidates busy, waiting for next round
+                SEARCH_FREE         //!< Free channel found and not yet used
+            };
+
+            /**
+             * Listen before talk statistics
+             */
+            typedef struct {
+                    uint32_t Searches;      //!< Number of background searches started
+                    uint32_t Found;         //!< Number of background searches that found a free channel
+                    uint32_t Timeouts;      //!< Number of background searches that timed out
+                    uint32_t Probes;        //!< Number of channels probed
+                    uint32_t Busy;          //!< Number of probes that found the channel busy
+                    uint32_t RadioBusy;     //!< Number of background rounds skipped while the radio was in use
+                    uint32_t LastSearchMs;  //!< Duration of the last background search
+                    int16_t LastRssi;       //!< RSSI of the last probe
+            } LbtStats;
+
+            /**
+             * ChannelSearch constructor
+             * @param plan ChannelPlan used for channel frequencies, radio and LBT settings
+             */
+            ChannelSearch(ChannelPlan* plan);
+
+            /**
+             * ChannelSearch destructor
+             */
+            ~ChannelSearch();
+
+            /**
+             * Set the event queue used to run the background search
+             */
+            void SetEventQueue(EventQueue* queue);
+
+            /**
+             * Set the callback posted to the event queue when a background search completes
+             * @param cb called with LORA_OK and the free channel, or LORA_LBT_CHANNEL_BUSY on timeout
+             */
+            void SetCallback(Callback<void(uint8_t, uint8_t)> cb);
+
+            /**
+             * Select a free channel from the candidates
+             * Uses the result of a completed background search if still valid, else probes
+             * the least occupied candidates and starts a background search if all are busy
+             * @param channels candidate channel indexes
+             * @param count number of candidates
+             * @param[out] channel free channel index
+             * @return LORA_OK if a free channel was found
+             * @return LORA_LBT_CHANNEL_BUSY if all probed channels were busy or a search is in progress
+             */
+            uint8_t Select(const uint8_t* channels, uint8_t count, uint8_t& channel);
+
+            /**
+             * Start a background search
+             * @param channels candidate channel indexes
+             * @param count number of candidates
+             * @param timeout ms to search before giving up
+             * @return LORA_OK if search was started
+             */
+            uint8_t Start(const uint8_t* channels, uint8_t count, uint32_t timeout = LBT_SEARCH_TIMEOUT);
+
+            /**
+             * Cancel a background search and discard any result
+             */
+            void Cancel();
+
+            /**
+             * Get the state of the background search
+             */
+            State GetState();
+
+            /**
+             * Get listen before talk statistics
+             */
+            const LbtStats& GetStats();
+
+            /**
+             * Reset listen before talk statistics and channel occupancy
+             */
+            void ResetStats();
+
+            /**
+             * Get the estimated occupancy of a channel
+             * @param channel index
+             * @return 0 (always free) to 255 (always busy)
+             */
+            uint8_t GetOccupancy(uint8_t channel);
+
+        private:
+
+            void Prioritize(const uint8_t* channels, uint8_t count);
+            void Schedule(int delay_ms);
+            void Step();
+            bool Probe(uint8_t channel, int16_t& rssi);
+            void ProbeDone(bool busy, int16_t rssi);
+            void Finish(uint8_t status);
+            void Record(uint8_t channel, bool busy, int16_t rssi);
+
+            ChannelPlan* _plan;
+            EventQueue* _queue;
+            Callback<void(uint8_t, uint8_t)> _callback;
+
+            volatile State _state;
+
+            uint8_t _candidates[LBT_MAX_CHANNELS];      //!< Candidates in priority order
+            uint8_t _count;                             //!< Number of candidates
+            uint8_t _next;                              //!< Next candidate to probe
+            uint8_t _freeChannel;                       //!< Channel found free by the background search
+            uint8_t _occupancy[LBT_MAX_CHANNELS];       //!< Moving average of busy probes per channel
+
+            uint32_t _timeout;
+            int _evtId;
+            Timer _searchTimer;
+            Timer _freeTimer;
+
+            LbtStats _stats;
+    };
+}
+
+#endif // __CHANNEL_SEARCH_H__
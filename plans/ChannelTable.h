@@ -0,0 +1,166 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::ChannelTable bitmap index of channel plan channels
+ *
+ * @details
+ *  Keeps one channel bitmap per datarate, a bitmap of defined channels and the
+ *  duty band of each channel, laid out like the channel mask. Channel selection
+ *  and mask validation are then done a mask word at a time instead of reading
+ *  every Channel and searching duty bands by frequency.
+ *
+ *  The table is an index of the plan channels. It is rebuilt from the plan when
+ *  invalidated or when the number of channels changes.
+ */
+
+#ifndef __CHANNEL_TABLE_H__
+#define __CHANNEL_TABLE_H__
+
+#include "ChannelPlan.h"
+
+namespace lora {
+
+    const uint8_t CHANNEL_TABLE_DATARATES = 16;     //!< Number of datarates indexed
+
+    /**
+     * Bits of mask word covering channels first up to but not including last
+     */
+    inline uint16_t ChannelRangeBits(uint8_t first, uint8_t last, uint8_t word) {
+        int lo = first - word * 16;
+        int hi = last - word * 16;
+
+        if (lo < 0)
+            lo = 0;
+        if (hi > 16)
+            hi = 16;
+        if (hi <= lo)
+            return 0;
+
+        return (uint16_t) (((1UL << hi) - 1) & ~((1UL << lo) - 1));
+    }
+
+    template <uint8_t N>
+    class ChannelTable {
+        public:
+
+            static const uint8_t WORDS = (N + 15) / 16;     //!< Number of 16 bit words per bitmap
+
+            ChannelTable() {
+                Invalidate();
+            }
+
+            /**
+             * Mark table for rebuild on next Sync
+             */
+            void Invalidate() {
+                _valid = false;
+            }
+
+            /**
+             * Rebuild the table if it was invalidated or the plan channel count changed
+             * @param plan channel plan to index
+             */
+            void Sync(ChannelPlan* plan) {
+                // Fixed plans may compute channels instead of storing them, read through GetChannel
+                uint8_t count = plan->GetNumberOfChannels() < N ? plan->GetNumberOfChannels() : N;
+
+                if (_valid && _count == count)
+                    return;
+
+                memset(_datarates, 0, sizeof(_datarates));
+                memset(_defined, 0, sizeof(_defined));
+                memset(_bands, -1, sizeof(_bands));
+
+                _count = count;
+
+                for (uint8_t i = 0; i < _count; i++) {
+                    Channel chan = plan->GetChannel(i);
+                    uint16_t bit = 1 << (i % 16);
+
+                    for (uint8_t dr = chan.DrRange.Fields.Min; dr <= chan.DrRange.Fields.Max && dr < CHANNEL_TABLE_DATARATES; dr++) {
+                        _datarates[dr][i / 16] |= bit;
+                    }
+
+                    if (chan.Frequency != 0) {
+                        _defined[i / 16] |= bit;
+                        _bands[i] = plan->GetDutyBand(chan.Frequency);
+                    }
+                }
+
+                _valid = true;
+            }
+
+            /**
+             * Select enabled channels that allow a datarate and whose duty band is available
+             * @param dr datarate index
+             * @param mask channel mask
+             * @param first first channel to consider
+             * @param last channel after the last to consider
+             * @param bands duty bands of plan
+             * @param[out] out selected channel indexes, room for last - first entries
+             * @return number of channels selected
+             */
+            uint8_t Select(uint8_t dr, ArrayView<uint16_t> mask, uint8_t first, uint8_t last, const std::vector<DutyBand>& bands, uint8_t* out) const {
+                uint8_t count = 0;
+
+                if (dr >= CHANNEL_TABLE_DATARATES)
+                    return 0;
+
+                if (last > _count)
+                    last = _count;
+
+                for (uint8_t w = first / 16; w < WORDS && w < mask.size() && w * 16 < last; w++) {
+                    uint32_t bits = mask[w] & _datarates[dr][w] & ChannelRangeBits(first, last, w);
+
+                    while (bits != 0) {
+                        uint8_t i = w * 16 + __builtin_ctz(bits);
+                        int8_t band = _bands[i];
+
+                        bits &= bits - 1;
+
+                        if (band != -1 && bands[band].TimeOffEnd == 0) {
+                            out[count++] = i;
+                        }
+                    }
+                }
+
+                return count;
+            }
+
+            /**
+             * Check if a channel mask enables channels that have no frequency
+             * @param mask channel mask
+             * @param first first channel to check
+             * @param last channel after the last to check
+             */
+            bool EnablesUndefined(ArrayView<uint16_t> mask, uint8_t first, uint8_t last) const {
+                for (uint8_t w = first / 16; w < WORDS && w < mask.size() && w * 16 < last; w++) {
+                    if (mask[w] & ~_defined[w] & ChannelRangeBits(first, last, w))
+                        return true;
+                }
+
+                return false;
+            }
+
+            /**
+             * Get duty band of a channel, -1 if none or channel is not defined
+             */
+            int8_t GetBand(uint8_t channel) const {
+                return channel < _count ? _bands[channel] : -1;
+            }
+
+        private:
+
+            uint16_t _datarates[CHANNEL_TABLE_DATARATES][WORDS];    //!< Channels allowing each datarate
+            uint16_t _defined[WORDS];                               //!< Channels with a frequency
+            int8_t _bands[N];                                       //!< Duty band of each channel
+            uint8_t _count;                                         //!< Number of plan channels indexed
+            bool _valid;
+    };
+}
+
+#endif // __CHANNEL_TABLE_H__
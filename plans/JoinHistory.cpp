@@ -0,0 +1,184 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "JoinHistory.h"
+#include "Crc16.h"
+
+using namespace lora;
+
+static const uint8_t JOIN_HISTORY_MAGIC = 0x4A;
+static const uint8_t JOIN_HISTORY_NONE = 0x0F;
+
+JoinHistory::JoinHistory()
+:
+  _first(0),
+  _storage(false),
+  _loaded(false),
+  _tries(0),
+  _subBand(0),
+  _datarate(JOIN_HISTORY_NONE)
+{
+    _record.SubBand = 0;
+    _record.Datarate = JOIN_HISTORY_NONE;
+    ResetBackoff();
+}
+
+void JoinHistory::SetStorage(Callback<bool(uint32_t, uint32_t&)> read, Callback<bool(uint32_t, uint32_t)> write, uint32_t first) {
+    _read = read;
+    _write = write;
+    _first = first;
+    _storage = true;
+    _loaded = false;
+}
+
+JoinHistory::Record& JoinHistory::Get() {
+    return _record;
+}
+
+bool JoinHistory::GetLearned(uint8_t maxDatarate, uint8_t fixedSubBand, uint8_t& subBand, uint8_t& datarate) {
+    // The join datarate is picked before the first backoff is calculated after power up
+    LoadOnce();
+
+    if (_record.Datarate == JOIN_HISTORY_NONE || _tries >= JOIN_HISTORY_TRIES)
+        return false;
+
+    if (_record.Datarate > maxDatarate || (fixedSubBand != 0 && fixedSubBand != _record.SubBand))
+        return false;
+
+    _tries++;
+    subBand = _record.SubBand;
+    datarate = _record.Datarate;
+    return true;
+}
+
+void JoinHistory::Attempt(uint8_t subBand, uint8_t datarate) {
+    _subBand = subBand;
+    _datarate = datarate;
+}
+
+void JoinHistory::Restore(Settings* settings) {
+    LoadOnce();
+
+    // Join duty cycle budget is kept across sleep and reset
+    if (settings->Session.JoinFirstAttempt == 0 && _record.JoinFirstAttempt != 0 && _record.JoinFirstAttempt <= (uint32_t) time(NULL)) {
+        logDebug("Restoring join history first attempt: %lu time on air: %lu", _record.JoinFirstAttempt, _record.JoinTimeOnAir);
+        settings->Session.JoinFirstAttempt = _record.JoinFirstAttempt;
+        settings->Session.JoinTimeOnAir = _record.JoinTimeOnAir;
+    }
+}
+
+void JoinHistory::Backoff(Settings* settings) {
+    _record.JoinFirstAttempt = settings->Session.JoinFirstAttempt;
+    _record.JoinTimeOnAir = settings->Session.JoinTimeOnAir;
+    Save();
+}
+
+void JoinHistory::Joined() {
+    if (_datarate != JOIN_HISTORY_NONE) {
+        logDebug("Join history learned sub band: %d datarate: %d", _subBand, _datarate);
+        _record.SubBand = _subBand;
+        _record.Datarate = _datarate;
+    }
+
+    _tries = 0;
+    ResetBackoff();
+    Save();
+}
+
+void JoinHistory::Clear() {
+    _record.SubBand = 0;
+    _record.Datarate = JOIN_HISTORY_NONE;
+    _tries = 0;
+    ResetBackoff();
+    Save();
+}
+
+void JoinHistory::LoadOnce() {
+    if (!_loaded) {
+        _loaded = true;
+        Load();
+    }
+}
+
+void JoinHistory::ResetBackoff() {
+    _record.JoinCount = 0;
+    _record.JoinFirstAttempt = 0;
+    _record.JoinTimeOnAir = 0;
+    _record.TimeOffMax = JOIN_HISTORY_TIME_OFF;
+}
+
+bool JoinHistory::Load() {
+    uint32_t words[JOIN_HISTORY_WORDS];
+
+    if (!_storage)
+        return false;
+
+    for (uint8_t i = 0; i < JOIN_HISTORY_WORDS; i++) {
+        if (!_read(_first + i, words[i])) {
+            logError("Failed to read join history");
+            return false;
+        }
+    }
+
+    if ((words[0] >> 24) != JOIN_HISTORY_MAGIC || (words[3] & 0xFFFF) != Crc(words)) {
+        logDebug("No join history found");
+        return false;
+    }
+
+    _record.SubBand = (words[0] >> 20) & 0x0F;
+    _record.Datarate = (words[0] >> 16) & 0x0F;
+    _record.JoinCount = words[0] & 0xFFFF;
+    _record.JoinFirstAttempt = words[1];
+    _record.JoinTimeOnAir = words[2];
+    _record.TimeOffMax = words[3] >> 16;
+
+    logDebug("Loaded join history sub band: %d datarate: %d", _record.SubBand, _record.Datarate);
+    return true;
+}
+
+bool JoinHistory::Save() {
+    uint32_t words[JOIN_HISTORY_WORDS];
+
+    if (!_storage)
+        return false;
+
+    words[0] = (JOIN_HISTORY_MAGIC << 24) | ((_record.SubBand & 0x0F) << 20) | ((_record.Datarate & 0x0F) << 16) | _record.JoinCount;
+    words[1] = _record.JoinFirstAttempt;
+    words[2] = _record.JoinTimeOnAir;
+    words[3] = (_record.TimeOffMax > 0xFFFF ? 0xFFFF : _record.TimeOffMax) << 16;
+    words[3] |= Crc(words);
+
+    for (uint8_t i = 0; i < JOIN_HISTORY_WORDS; i++) {
+        if (!_write(_first + i, words[i])) {
+            logError("Failed to write join history");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint16_t JoinHistory::Crc(const uint32_t* words) {
+    // CRC-16 CCITT over the record words, excluding the CRC itself
+    uint16_t crc = CRC16_RECORD_INIT;
+
+    for (uint8_t i = 0; i < JOIN_HISTORY_WORDS * 4 - 2; i++) {
+        crc = Crc16::Update(crc, words[i / 4] >> (24 - (i % 4) * 8));
+    }
+
+    return crc;
+}
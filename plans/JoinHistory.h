@@ -0,0 +1,124 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ * @brief  lora::JoinHistory keeps join backoff state and the last successful join configuration
+ *
+ * @details
+ *  The record holds the sub band and datarate of the last successful join along
+ *  with the join duty cycle state (first attempt, accumulated time on air, backoff
+ *  counters). Join attempts start with the learned configuration before falling
+ *  back to cycling through sub bands and datarates.
+ *
+ *  The record is packed into JOIN_HISTORY_WORDS 32-bit words and can be kept
+ *  across sleep and reset by providing read and write functions, for example
+ *  mDot::readUserBackupRegister and mDot::writeUserBackupRegister.
+ */
+
+#ifndef __JOIN_HISTORY_H__
+#define __JOIN_HISTORY_H__
+
+#include "mbed.h"
+
+#include "Lora.h"
+
+namespace lora {
+
+    const uint8_t JOIN_HISTORY_WORDS = 4;           //!< Number of 32-bit words used to store the record
+    const uint8_t JOIN_HISTORY_TRIES = 2;           //!< Join attempts made with the learned configuration before cycling
+    const uint32_t JOIN_HISTORY_TIME_OFF = 15;      //!< Initial max time off between join attempts in seconds
+
+    class JoinHistory {
+        public:
+
+            /**
+             * Persisted join state
+             */
+            typedef struct {
+                    uint8_t SubBand;            //!< Frequency sub band of last successful join, 0 if none
+                    uint8_t Datarate;           //!< Datarate of last successful join, 0xF if none
+                    uint16_t JoinCount;         //!< Join requests sent in the current backoff period
+                    uint32_t JoinFirstAttempt;  //!< RTC time of first failed join attempt
+                    uint32_t JoinTimeOnAir;     //!< Balance of time on air used during join attempts
+                    uint32_t TimeOffMax;        //!< Current max time off between join attempts in seconds
+            } Record;
+
+            /**
+             * JoinHistory constructor
+             */
+            JoinHistory();
+
+            /**
+             * Set storage for the record, state is kept in RAM only if not set
+             * @param read function to read a word
+             * @param write function to write a word
+             * @param first index of first of JOIN_HISTORY_WORDS words to use
+             */
+            void SetStorage(Callback<bool(uint32_t, uint32_t&)> read, Callback<bool(uint32_t, uint32_t)> write, uint32_t first);
+
+            /**
+             * Get the record
+             */
+            Record& Get();
+
+            /**
+             * Get the learned configuration to use for the next join attempt
+             * A try is only counted when the configuration is returned
+             * @param maxDatarate highest datarate the plan allows for joins
+             * @param fixedSubBand sub band configured by the user, 0 if any sub band may be used
+             * @param[out] subBand sub band of last successful join
+             * @param[out] datarate datarate of last successful join
+             * @return true if the learned configuration should be tried
+             */
+            bool GetLearned(uint8_t maxDatarate, uint8_t fixedSubBand, uint8_t& subBand, uint8_t& datarate);
+
+            /**
+             * Configuration used by the join request being sent
+             */
+            void Attempt(uint8_t subBand, uint8_t datarate);
+
+            /**
+             * Load the record once and restore join duty cycle state lost from the session
+             */
+            void Restore(Settings* settings);
+
+            /**
+             * Store join duty cycle state after a join backoff was calculated
+             */
+            void Backoff(Settings* settings);
+
+            /**
+             * Last join attempt was accepted, learn its configuration and clear the backoff state
+             */
+            void Joined();
+
+            /**
+             * Forget learned configuration and backoff state
+             */
+            void Clear();
+
+        private:
+
+            void LoadOnce();
+            bool Load();
+            bool Save();
+            void ResetBackoff();
+            static uint16_t Crc(const uint32_t* words);
+
+            Callback<bool(uint32_t, uint32_t&)> _read;
+            Callback<bool(uint32_t, uint32_t)> _write;
+            uint32_t _first;
+            bool _storage;
+            bool _loaded;
+
+            Record _record;
+            uint8_t _tries;                     //!< Attempts made with the learned configuration
+            uint8_t _subBand;                   //!< Sub band of current join attempt
+            uint8_t _datarate;                  //!< Datarate of current join attempt
+    };
+}
+
+#endif // __JOIN_HISTORY_H__
@@ -0,0 +1,201 @@
+/**********************************************************************
+* COPYRIGHT 2020 MULTI-TECH SYSTEMS, INC.
+*
+* ALL RIGHTS RESERVED BY AND FOR THE EXCLUSIVE BENEFIT OF
+* MULTI-TECH SYSTEMS, INC.
+*
+* MULTI-TECH SYSTEMS, INC. - CONFIDENTIAL AND PROPRIETARY
+* INFORMATION AND/OR TRADE SECRET.
+*
+* NOTICE: ALL CODE, PROGRAM, INFORMATION, SCRIPT, INSTRUCTION,
+* DATA, AND COMMENT HEREIN IS AND SHALL REMAIN THE CONFIDENTIAL
+* INFORMATION AND PROPERTY OF MULTI-TECH SYSTEMS, INC.
+* USE AND DISCLOSURE THEREOF, EXCEPT AS STRICTLY AUTHORIZED IN A
+* WRITTEN AGREEMENT SIGNED BY MULTI-TECH SYSTEMS, INC. IS PROHIBITED.
+*
+***********************************************************************/
+
+#include "MacCommandParser.h"
+#include "ChannelPlan.h"
+
+using namespace lora;
+
+static const MacCommandInfo MAC_COMMANDS[] = {
+    { SRV_MAC_LINK_CHECK_ANS, 2, 0, NULL },
+    { SRV_MAC_LINK_ADR_REQ, 4, MOTE_MAC_LINK_ADR_ANS, &ChannelPlan::HandleAdrCommand },
+    { SRV_MAC_DUTY_CYCLE_REQ, 1, MOTE_MAC_DUTY_CYCLE_ANS, NULL },
+    { SRV_MAC_RX_PARAM_SETUP_REQ, 4, MOTE_MAC_RX_PARAM_SETUP_ANS, &ChannelPlan::HandleRxParamSetup },
+    { SRV_MAC_DEV_STATUS_REQ, 0, MOTE_MAC_DEV_STATUS_ANS, NULL },
+    { SRV_MAC_NEW_CHANNEL_REQ, 5, MOTE_MAC_NEW_CHANNEL_ANS, &ChannelPlan::HandleNewChannel },
+    { SRV_MAC_RX_TIMING_SETUP_REQ, 1, MOTE_MAC_RX_TIMING_SETUP_ANS, NULL },
+    { SRV_MAC_TX_PARAM_SETUP_REQ, 1, MOTE_MAC_TX_PARAM_SETUP_ANS, NULL },
+    { SRV_MAC_DL_CHANNEL_REQ, 4, MOTE_MAC_DL_CHANNEL_ANS, &ChannelPlan::HandleDownlinkChannelReq },
+    { SRV_MAC_REKEY_CONF, 1, 0, NULL },
+    { SRV_MAC_ADR_PARAM_SETUP_REQ, 1, MOTE_MAC_ADR_PARAM_SETUP_ANS, NULL },
+    { SRV_MAC_DEVICE_TIME_ANS, 5, 0, NULL },
+    { SRV_MAC_FORCE_REJOIN_REQ, 2, 0, NULL },
+    { SRV_MAC_REJOIN_PARAM_SETUP_REQ, 1, MOTE_MAC_REJOIN_PARAM_SETUP_ANS, NULL },
+    { SRV_MAC_PING_SLOT_INFO_ANS, 0, 0, NULL },
+    { SRV_MAC_PING_SLOT_CHANNEL_REQ, 4, MOTE_MAC_PING_SLOT_CHANNEL_ANS, &ChannelPlan::HandlePingSlotChannelReq },
+    { SRV_MAC_BEACON_TIMING_ANS, 3, 0, NULL },
+    { SRV_MAC_BEACON_FREQ_REQ, 3, MOTE_MAC_BEACON_FREQ_ANS, &ChannelPlan::HandleBeaconFrequencyReq },
+};
+
+static const uint8_t MAC_COMMANDS_SIZE = sizeof(MAC_COMMANDS) / sizeof(MAC_COMMANDS[0]);
+
+MacCommandParser::MacCommandParser(ChannelPlan* plan)
+:
+  _plan(plan),
+  _count(0),
+  _complete(true)
+{
+}
+
+const MacCommandInfo* MacCommandParser::Lookup(uint8_t cid) {
+    // Table is ordered by identifier starting at LinkCheckAns
+    uint8_t i = cid - SRV_MAC_LINK_CHECK_ANS;
+
+    if (cid < SRV_MAC_LINK_CHECK_ANS || i >= MAC_COMMANDS_SIZE)
+        return NULL;
+
+    return &MAC_COMMANDS[i];
+}
+
+uint8_t MacCommandParser::Parse(const uint8_t* payload, uint8_t size) {
+    uint8_t index = 0;
+
+    _count = 0;
+    _complete = false;
+
+    while (index < size && _count < MAC_COMMAND_MAX) {
+        const MacCommandInfo* info = Lookup(payload[index]);
+
+        if (info == NULL) {
+            logWarning("Unknown MAC command 0x%02x, ignoring rest of payload", payload[index]);
+            return _count;
+        }
+
+        if (index + 1 + info->Length > size) {
+            logWarning("Truncated MAC command 0x%02x", payload[index]);
+            return _count;
+        }
+
+        _commands[_count].Index = index;
+        _commands[_count].Info = info;
+        _count++;
+
+        index += 1 + info->Length;
+    }
+
+    _complete = (index == size);
+    return _count;
+}
+
+bool MacCommandParser::IsComplete() {
+    return _complete;
+}
+
+uint8_t MacCommandParser::GetCount() {
+    return _count;
+}
+
+const MacCommand& MacCommandParser::GetCommand(uint8_t i) {
+    return _commands[i];
+}
+
+uint8_t MacCommandParser::Apply(const uint8_t* payload, uint8_t size) {
+    uint8_t applied = 0;
+    uint8_t i = 0;
+
+    Parse(payload, size);
+
+    while (i < _count) {
+        const MacCommandInfo* info = _commands[i].Info;
+
+        if (info->Cid == SRV_MAC_LINK_ADR_REQ) {
+            uint8_t last = i + 1;
+
+            while (last < _count && _commands[last].Info->Cid == SRV_MAC_LINK_ADR_REQ)
+                last++;
+
+            applied += ApplyAdrBlock(payload, size, i, last);
+            i = last;
+            continue;
+        }
+
+        if (info->Handler != NULL) {
+            uint8_t status = 0;
+
+            (_plan->*info->Handler)(payload, _commands[i].Index + 1, size, status);
+            AddAnswer(info->Answer, status);
+            applied++;
+        }
+
+        i++;
+    }
+
+    return applied;
+}
+
+uint8_t MacCommandParser::ApplyAdrBlock(const uint8_t* payload, uint8_t size, uint8_t first, uint8_t last) {
+    Settings* settings = _plan->GetSettings();
+    ArrayView<uint16_t> view = _plan->GetChannelMaskView();
+    uint16_t masks[MAC_COMMAND_MASK_WORDS];
+    uint8_t words = view.size() < MAC_COMMAND_MASK_WORDS ? view.size() : MAC_COMMAND_MASK_WORDS;
+    uint8_t datarate = settings->Session.TxDatarate;
+    uint8_t power = settings->Session.TxPower;
+    uint8_t redundancy = settings->Session.Redundancy;
+    uint8_t status = 0x07;
+
+    for (uint8_t i = 0; i < words; i++) {
+        masks[i] = view[i];
+    }
+
+    for (uint8_t i = first; i < last; i++) {
+        uint8_t cmd_status = 0x07;
+
+        _plan->HandleAdrCommand(payload, _commands[i].Index + 1, size, cmd_status);
+        status &= cmd_status;
+    }
+
+    // Configuration is checked once for the whole block
+    status &= _plan->ValidateAdrConfiguration();
+
+    if (status != 0x07) {
+        logWarning("LinkADRReq block rejected status: %02x", status);
+
+        view = _plan->GetChannelMaskView();
+
+        for (uint8_t i = 0; i < words && i < view.size(); i++) {
+            if (view[i] != masks[i])
+                _plan->SetChannelMask(i, masks[i]);
+        }
+
+        settings->Session.TxDatarate = datarate;
+        settings->Session.TxPower = power;
+        settings->Session.Redundancy = redundancy;
+    }
+
+    // Each request of the block is answered with the status of the block
+    for (uint8_t i = first; i < last; i++) {
+        AddAnswer(MOTE_MAC_LINK_ADR_ANS, status);
+    }
+
+    return last - first;
+}
+
+bool MacCommandParser::AddAnswer(uint8_t cid, uint8_t status) {
+    Settings* settings = _plan->GetSettings();
+
+    if (cid == 0)
+        return true;
+
+    if (settings->Session.CommandBufferIndex + 2 > COMMANDS_BUFFER_SIZE) {
+        logWarning("MAC command buffer full, dropping answer 0x%02x", cid);
+        return false;
+    }
+
+    settings->Session.CommandBuffer[settings->Session.CommandBufferIndex++] = cid;
+    settings->Session.CommandBuffer[settings->Session.CommandBufferIndex++] = status;
+    return true;
+}
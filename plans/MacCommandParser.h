@@ -0,0 +1,121 @@
+/**   __  ___     ____  _    ______        __     ____         __                  ____
+ *   /  |/  /_ __/ / /_(_)__/_  __/__ ____/ /    / __/_ _____ / /____ __ _  ___   /  _/__  ____
+ *  / /|_/ / // / / __/ /___// / / -_) __/ _ \  _\ \/ // (_-</ __/ -_)  ' \(_-<  _/ // _ \/ __/ __
+ * /_/  /_/\_,_/_/\__/_/    /_/  \__/\__/_//_/ /___/\_, /___/\__/\__/_/_/_/___/ /___/_//_/\__/ /_/
+ * Copyright (C) 2020 by Multi-Tech Systems        /___/
+ *
+ *
+ *
+ * @brief  lora::MacCommandParser table driven parser for downlink MAC commands
+ *
+ * @details
+ *  Validates a whole FOpts field or port 0 payload in one pass against a table
+ *  of command lengths before anything is applied. Processing stops at the first
+ *  unknown command, as the length of the remaining commands is not known.
+ *
+ *  Apply hands each command to the channel plan handler and writes the answer
+ *  directly into Session.CommandBuffer. A contiguous block of LinkADRReq is
+ *  applied as a unit: the configuration is validated once for the block and the
+ *  channel mask, datarate, power and redundancy are restored if it is rejected.
+ *  Commands without a plan handler are left to the MAC.
+ */
+
+#ifndef __MAC_COMMAND_PARSER_H__
+#define __MAC_COMMAND_PARSER_H__
+
+#include "Lora.h"
+
+namespace lora {
+
+    class ChannelPlan;
+
+    const uint8_t MAC_COMMAND_MAX = 32;         //!< Max number of commands parsed from one payload
+    const uint8_t MAC_COMMAND_MASK_WORDS = 8;   //!< Max number of channel mask words restored for LinkADRReq
+
+    /**
+     * Plan handler for a server MAC command
+     */
+    typedef uint8_t (ChannelPlan::*MacCommandHandler)(const uint8_t* payload, uint8_t index, uint8_t size, uint8_t& status);
+
+    /**
+     * Server MAC command table entry
+     */
+    typedef struct {
+            uint8_t Cid;                    //!< Server command identifier
+            uint8_t Length;                 //!< Bytes following the identifier
+            uint8_t Answer;                 //!< Mote answer identifier, 0 if none
+            MacCommandHandler Handler;      //!< Plan handler, NULL if handled by the MAC
+    } MacCommandInfo;
+
+    /**
+     * Command found in a payload
+     */
+    typedef struct {
+            uint8_t Index;                  //!< Index of command identifier in payload
+            const MacCommandInfo* Info;     //!< Table entry of command
+    } MacCommand;
+
+    class MacCommandParser {
+        public:
+
+            /**
+             * MacCommandParser constructor
+             * @param plan ChannelPlan handling the commands
+             */
+            MacCommandParser(ChannelPlan* plan);
+
+            /**
+             * Find the table entry of a server command
+             * @param cid command identifier
+             * @return entry or NULL if command is unknown
+             */
+            static const MacCommandInfo* Lookup(uint8_t cid);
+
+            /**
+             * Split a payload into commands
+             * @param payload FOpts or port 0 payload
+             * @param size number of bytes in payload
+             * @return number of commands found before the end or the first unknown command
+             */
+            uint8_t Parse(const uint8_t* payload, uint8_t size);
+
+            /**
+             * Check if the last parsed payload was consumed entirely
+             * @return false if an unknown or truncated command stopped parsing
+             */
+            bool IsComplete();
+
+            /**
+             * Get number of commands found by Parse
+             */
+            uint8_t GetCount();
+
+            /**
+             * Get a command found by Parse
+             * @param i index of command
+             */
+            const MacCommand& GetCommand(uint8_t i);
+
+            /**
+             * Parse a payload and apply the commands that have a plan handler
+             * Answers are added to Session.CommandBuffer while it has room
+             * @param payload FOpts or port 0 payload
+             * @param size number of bytes in payload
+             * @return number of commands applied
+             */
+            uint8_t Apply(const uint8_t* payload, uint8_t size);
+
+        private:
+
+            uint8_t ApplyAdrBlock(const uint8_t* payload, uint8_t size, uint8_t first, uint8_t last);
+            bool AddAnswer(uint8_t cid, uint8_t status);
+
+            ChannelPlan* _plan;
+
+            MacCommand _commands[MAC_COMMAND_MAX];
+            uint8_t _count;
+            bool _complete;                 //!< Last payload parsed to the end
+    };
+}
+
+#endif // __MAC_COMMAND_PARSER_H__